@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+
+import argparse
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        prog="alancov",
+        description="Annotate an Alan file with execution counts.",
+    )
+    parser.add_argument(
+        "coverage",
+        type=str,
+        metavar="COVERAGE",
+        help="coverage file written by a program compiled with --coverage",
+    )
+    parser.add_argument(
+        "-s",
+        type=str,
+        metavar="SOURCE",
+        dest="source",
+        help="source file (default: the one recorded in COVERAGE)",
+    )
+    parser.add_argument(
+        "--uncovered",
+        action="store_true",
+        help="only print lines that never ran",
+    )
+    return parser.parse_args()
+
+
+def read_coverage(filename: str):
+    """Function to read a coverage file.
+
+    Parameters
+    ----------
+
+    filename: str
+        Coverage file.
+
+    Returns
+    -------
+
+    source: str
+        Source file recorded in the coverage file.
+
+    counts: dict
+        Execution count of every line with statements.
+    """
+    counts = {}
+    with open(filename, "r") as fp:
+        source = fp.readline().rstrip("\n").partition(" ")[2]
+        for line in fp:
+            number, count = line.split()
+            counts[int(number)] = int(count)
+    return source, counts
+
+
+def annotate(source: str, counts: dict, uncovered: bool):
+    """Function to print the source with the count of every line.
+
+    Lines without statements get `-`, lines that never ran get `#####`.
+
+    Parameters
+    ----------
+
+    source: str
+        Source file.
+
+    counts: dict
+        Execution count of every line with statements.
+
+    uncovered: bool
+        Print only lines that never ran.
+    """
+    with open(source, "r") as fp:
+        for number, text in enumerate(fp, start=1):
+            count = counts.get(number)
+            if count is None:
+                mark = "-"
+            elif count == 0:
+                mark = "#####"
+            else:
+                mark = str(count)
+            if uncovered and count != 0:
+                continue
+            print(f"{mark:>9}:{number:>5}:{text}", end="")
+    covered = sum(1 for count in counts.values() if count > 0)
+    if counts:
+        percent = 100.0 * covered / len(counts)
+        print(f"\nLines executed: {percent:.2f}% of {len(counts)}")
+
+
+if __name__ == "__main__":
+    args = parse_arguments()
+    source, counts = read_coverage(args.coverage)
+    annotate(args.source or source, counts, args.uncovered)
@@ -4,6 +4,11 @@ import os
 import subprocess as sp
 import argparse
 import shutil
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
+
+# Most partitions a module is split into with -j; -j only sizes the pool
+PARTITIONS = 8
 
 
 def parse_arguments():
@@ -14,15 +19,62 @@ def parse_arguments():
         "--version", action="version", version="Alan Compiler v0.0.2"
     )
     parser.add_argument(
-        "filename", type=str, metavar="FILENAME", help="file to compile"
+        "filenames",
+        type=str,
+        nargs="+",
+        metavar="FILENAME",
+        help="file to compile, followed by objects (.o) of the modules it "
+        "uses or by their interfaces (.ali)",
     )
     parser.add_argument(
         "-o",
         type=str,
         metavar="OUTPUT",
         dest="output",
-        help="output file",
-        default="a.out",
+        help="output file (default: a.out, or FILENAME.o with -c)",
+    )
+    parser.add_argument(
+        "-g",
+        action="store_true",
+        dest="debug",
+        help="generate DWARF debug information",
+    )
+    parser.add_argument(
+        "--instrument-functions",
+        action="store_true",
+        dest="instrument",
+        help="count calls and cycles of every function, reported at exit",
+    )
+    parser.add_argument(
+        "--coverage",
+        action="store_true",
+        help="count executions of every statement (see alancov)",
+    )
+    parser.add_argument(
+        "--stack-array-limit",
+        type=int,
+        metavar="BYTES",
+        dest="stack_array_limit",
+        help="local arrays bigger than BYTES are kept off the stack",
+    )
+    parser.add_argument(
+        "--wrapv",
+        action="store_true",
+        help="make int overflow wrap around instead of being undefined",
+    )
+    parser.add_argument(
+        "--ast-cache",
+        action="store_true",
+        dest="ast_cache",
+        help="keep the checked ast in FILENAME.ast and reuse it while "
+        "the source is unchanged",
+    )
+    parser.add_argument(
+        "--eval-steps",
+        type=int,
+        metavar="STEPS",
+        dest="eval_steps",
+        help="budget of each call evaluated at compile time (0 disables)",
     )
     intermediate = parser.add_argument_group(
         title="intermediate compilations"
@@ -33,6 +85,19 @@ def parse_arguments():
     intermediate.add_argument(
         "-S", action="store_true", help="compile to assembly"
     )
+    intermediate.add_argument(
+        "-c",
+        action="store_true",
+        help="compile a module to an object and its interface (.ali)",
+    )
+    intermediate.add_argument(
+        "--dump-ast",
+        nargs="?",
+        const="text",
+        choices=["text", "json"],
+        dest="dump_ast",
+        help="print the checked ast (text or json) and stop",
+    )
     opts = parser.add_argument_group(
         title="optimization options"
     ).add_mutually_exclusive_group()
@@ -65,7 +130,85 @@ def parse_arguments():
         const="-O3",
         help="enable all optimizations",
     )
-    return parser.parse_args()
+    remarks = parser.add_argument_group(title="optimization remarks")
+    remarks.add_argument(
+        "-Rpass",
+        type=str,
+        metavar="REGEX",
+        dest="rpass",
+        help="report the optimizations done by passes matching REGEX",
+    )
+    remarks.add_argument(
+        "-Rpass-missed",
+        type=str,
+        metavar="REGEX",
+        dest="rpass_missed",
+        help="report the optimizations missed by passes matching REGEX",
+    )
+    remarks.add_argument(
+        "-Rpass-analysis",
+        type=str,
+        metavar="REGEX",
+        dest="rpass_analysis",
+        help="report why passes matching REGEX missed an optimization",
+    )
+    remarks.add_argument(
+        "-fsave-optimization-record",
+        action="store_true",
+        dest="save_record",
+        help="save every remark to FILENAME.opt.yaml",
+    )
+    profile = parser.add_argument_group(
+        title="profile guided optimization"
+    ).add_mutually_exclusive_group()
+    profile.add_argument(
+        "-fprofile-generate",
+        action="store_true",
+        dest="profile_generate",
+        help="instrument the program to write a profile when it runs",
+    )
+    profile.add_argument(
+        "-fprofile-use",
+        type=str,
+        metavar="PROFILE",
+        dest="profile_use",
+        help="optimize using a .profraw or merged .profdata profile",
+    )
+    target = parser.add_argument_group(title="target options")
+    target.add_argument(
+        "--target",
+        type=str,
+        metavar="TRIPLE",
+        help="target triple (default: the host)",
+    )
+    target.add_argument(
+        "-march",
+        type=str,
+        choices=["native"],
+        help="use every feature of the host cpu",
+    )
+    target.add_argument(
+        "-mcpu", type=str, metavar="CPU", help="target cpu (e.g. haswell)"
+    )
+    backend = parser.add_argument_group(title="backend options")
+    backend.add_argument(
+        "-j",
+        type=int,
+        metavar="JOBS",
+        dest="jobs",
+        help="split the module and optimize/emit the parts on JOBS threads",
+        default=None,
+    )
+    args = parser.parse_args()
+    args.sources = [
+        f for f in args.filenames if not f.endswith((".o", ".ali"))
+    ]
+    if len(args.sources) != 1:
+        parser.error("exactly one Alan source file is needed")
+    args.filename = args.sources[0]
+    if args.jobs is not None and args.jobs < 1:
+        parser.error("-j needs at least one job")
+    return args
 
 
 def updir(path, num=1):
@@ -105,7 +248,7 @@ def cleanup(*args):
             shutil.rmtree(arg)
 
 
-def compile_llvm(filename: str, cmd: str, temp: str):
+def compile_llvm(filename: str, cmd: str, temp: str, flags: list):
     """Function to compile to LLVM IR.
 
     Parameters
@@ -120,6 +263,9 @@ def compile_llvm(filename: str, cmd: str, temp: str):
     temp: str
         Path to save temporary files.
 
+    flags: list
+        Options passed to the compiler.
+
     Returns
     -------
 
@@ -130,11 +276,90 @@ def compile_llvm(filename: str, cmd: str, temp: str):
     llvm = os.path.join(temp, f"{llvm}.ll")
     with open(filename, "r") as fp:
         with open(llvm, "w") as gp:
-            sp.run([cmd, filename], stdin=fp, stdout=gp)
+            sp.run([cmd, *flags, filename], stdin=fp, stdout=gp)
     return llvm
 
 
-def compile_optimizations(filename: str, cmd: str, opts: str):
+def merge_profile(filename: str, cmd: str, temp: str):
+    """Function to merge a raw profile into an indexed one.
+
+    Parameters
+    ----------
+
+    filename: str
+        Profile to merge (already merged profiles are returned as is).
+
+    cmd: str
+        Command to run.
+
+    temp: str
+        Path to save temporary files.
+
+    Returns
+    -------
+
+    filename: str
+        Indexed profile usable by opt.
+    """
+    if not filename.endswith(".profraw"):
+        return filename
+    profdata = os.path.basename(filename).rpartition(".")[0]
+    profdata = os.path.join(temp, f"{profdata}.profdata")
+    sp.run([cmd, "merge", "-o", profdata, filename])
+    return profdata
+
+
+def remark_options(remarks: list, record: str):
+    """Function to build the remark options of opt and llc.
+
+    Parameters
+    ----------
+
+    remarks: list
+        Remark filters (-pass-remarks*), possibly empty.
+
+    record: str
+        File to save the remarks to, or None.
+
+    Returns
+    -------
+
+    options: list
+        Options to pass to opt or llc.
+    """
+    if record is None:
+        return remarks
+    return [*remarks, f"-pass-remarks-output={record}"]
+
+
+def save_remarks(filenames: list, output: str):
+    """Function to merge optimization records.
+
+    Parameters
+    ----------
+
+    filenames: list
+        Records written by opt and llc, in pipeline order; records of
+        stages that did not run are skipped.
+
+    output: str
+        Merged record (the YAML documents one after the other).
+    """
+    with open(output, "w") as fp:
+        for filename in filenames:
+            if os.path.isfile(filename):
+                with open(filename, "r") as gp:
+                    fp.write(gp.read())
+
+
+def compile_optimizations(
+    filename: str,
+    cmd: str,
+    opts: list,
+    remarks: list,
+    record: bool,
+    text: bool,
+):
     """Function to apply optimizations to LLVM IR.
 
     Parameters
@@ -146,13 +371,148 @@ def compile_optimizations(filename: str, cmd: str, opts: str):
     cmd: str
         Command to run.
 
-    opts: str
-        Optimizations to apply.
+    opts: list
+        Passes and optimization level to apply, in order.
+
+    remarks: list
+        Remark filters passed to opt.
+
+    record: bool
+        Save the remarks to filename.opt.yaml.
+
+    text: bool
+        Write textual IR (.ll) instead of bitcode (.bc).
+    """
+    record = f"{filename}.opt.yaml" if record else None
+    remarks = remark_options(remarks, record)
+    output = ["-S"] if text else []
+    sp.run([cmd, *output, *opts, *remarks, filename, "-o", filename])
+
+
+def count_partitions(filename: str):
+    """Function to choose how many partitions a module is split into.
+
+    Parameters
+    ----------
+
+    filename: str
+        LLVM IR of the module.
+
+    Returns
+    -------
+
+    partitions: int
+        One partition per defined function, at most PARTITIONS. It only
+        depends on the module, so every -j emits the same code.
+    """
+    with open(filename, "r") as fp:
+        functions = sum(1 for line in fp if line.startswith("define "))
+    return max(1, min(PARTITIONS, functions))
+
+
+def split_module(filename: str, cmd: str, partitions: int):
+    """Function to partition LLVM IR into independent modules.
+
+    Parameters
+    ----------
+
+    filename: str
+        File to split.
+
+    cmd: str
+        Command to run.
+
+    partitions: int
+        Number of partitions.
+
+    Returns
+    -------
+
+    filenames: list
+        Partitions in a fixed order, independent of scheduling.
     """
-    sp.run([cmd, "-S", opts, filename, "-o", filename])
+    prefix = filename.rpartition(".")[0] + ".part"
+    # Nested functions are internal to their module: keep them internal
+    # (and next to their callers) instead of promoting them to globals
+    # that could clash with the nested functions of other modules
+    sp.run(
+        [cmd, "-preserve-locals", f"-j={partitions}", filename, "-o", prefix]
+    )
+    parts = []
+    for i in range(partitions):
+        part = f"{prefix}{i}"
+        if os.path.isfile(part):
+            os.rename(part, f"{part}.bc")
+            parts.append(f"{part}.bc")
+    return parts
+
+
+def compile_parallel(
+    filenames: list,
+    opt: str,
+    llc: str,
+    opts: list,
+    temp: str,
+    jobs: int,
+    flags: list,
+    remarks: list,
+    record: bool,
+):
+    """Function to optimize and compile partitions to assembly on a pool.
 
+    Parameters
+    ----------
 
-def compile_assembly(filename: str, cmd: str, temp: str):
+    filenames: list
+        Partitions to compile.
+
+    opt: str
+        Optimizer to run.
+
+    llc: str
+        Compiler to run.
+
+    opts: list
+        Passes and optimization level to apply, in order.
+
+    temp: str
+        Path to save temporary files.
+
+    jobs: int
+        Number of threads.
+
+    flags: list
+        Target options passed to llc.
+
+    remarks: list
+        Remark filters passed to opt and llc.
+
+    record: bool
+        Save the remarks of every partition next to it.
+
+    Returns
+    -------
+
+    filenames: list
+        Assembly files, in the order of the partitions.
+    """
+
+    def backend(filename):
+        compile_optimizations(filename, opt, opts, remarks, record, False)
+        return compile_assembly(filename, llc, temp, flags, remarks, record)
+
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        return list(pool.map(backend, filenames))
+
+
+def compile_assembly(
+    filename: str,
+    cmd: str,
+    temp: str,
+    flags: list,
+    remarks: list,
+    record: bool,
+):
     """Function to compile to assembly.
 
     Parameters
@@ -167,29 +527,88 @@ def compile_assembly(filename: str, cmd: str, temp: str):
     temp: str
         Path to save temporary files.
 
+    flags: list
+        Target options passed to the compiler.
+
+    remarks: list
+        Remark filters passed to the compiler.
+
+    record: bool
+        Save the remarks to filename.llc.yaml.
+
     Returns
     -------
 
     filename: str
         Filename where code was saved.
     """
-    assembly = os.path.basename(filename).partition(".")[0]
+    assembly = os.path.basename(filename).rpartition(".")[0]
     assembly = os.path.join(temp, f"{assembly}.s")
+    record = f"{filename}.llc.yaml" if record else None
+    remarks = remark_options(remarks, record)
     with open(assembly, "w") as fp:
-        sp.run([cmd, filename], stdout=fp)
+        sp.run([cmd, *flags, *remarks, filename], stdout=fp)
     return assembly
 
 
+def module_interfaces(filenames: list):
+    """Function to find the interfaces of the modules to link.
+
+    Parameters
+    ----------
+
+    filenames: list
+        Input files; every object (.o) brings the interface (.ali) that
+        was written next to it by -c.
+
+    Returns
+    -------
+
+    interfaces: list
+        Absolute paths of the interfaces to import.
+    """
+    interfaces = []
+    for filename in filenames:
+        if filename.endswith(".ali"):
+            interfaces.append(os.path.abspath(filename))
+        elif filename.endswith(".o"):
+            interface = f"{os.path.splitext(filename)[0]}.ali"
+            if os.path.isfile(interface):
+                interfaces.append(os.path.abspath(interface))
+    return interfaces
+
+
+def compile_object(filenames: list, cmd: str, output: str):
+    """Function to produce the object of a module.
+
+    Parameters
+    ----------
+
+    filenames: list
+        Assembly files of the module (more than one with -j).
+
+    cmd: str
+        Command to run.
+
+    output: str
+        Name of the object file.
+    """
+    if len(filenames) == 1:
+        sp.run([cmd, "-c", filenames[0], "-o", output])
+    else:
+        sp.run([cmd, "-r", "-nostdlib", *filenames, "-o", output])
+
+
 def compile_executable(
-    filename: str, cmd: str, lib: str, output: str, execs: str
+    filenames: list, cmd: str, lib: str, output: str, execs: str, flags: list
 ):
     """Function to produce executable.
 
     Parameters
     ----------
 
-    filename: str
-        File to compile.
+    filenames: list
+        Files to compile and link together.
 
     cmd: str
         Command to run.
@@ -202,9 +621,12 @@ def compile_executable(
     
     execs: str
         Path to save executable files.
+
+    flags: list
+        Options passed to the linker.
     """
     output = os.path.join(execs, output)
-    sp.run([cmd, filename, lib, "-o", output])
+    sp.run([cmd, *filenames, lib, *flags, "-o", output])
 
 
 if __name__ == "__main__":
@@ -214,23 +636,136 @@ if __name__ == "__main__":
     lib = os.path.join(root, "libs", "libalanstd.a")
     opt = "opt-6.0"
     llc = "llc-6.0"
+    split = "llvm-split-6.0"
     linker = "clang-6.0"
-    temp = os.path.join(root, "tmp")
+    profdata = "llvm-profdata-6.0"
+    # Private temporary directory, so that modules can be built in parallel
+    os.makedirs(os.path.join(root, "tmp"), exist_ok=True)
+    temp = tempfile.mkdtemp(prefix="acc-", dir=os.path.join(root, "tmp"))
     execs = os.path.join(root, "execs")
-    os.makedirs(temp, exist_ok=True)
     os.makedirs(execs, exist_ok=True)
-    llvm = compile_llvm(args.filename, compiler, temp)
-    compile_optimizations(llvm, opt, args.opts)
+    flags = []
+    if args.debug:
+        flags.append("-g")
+    if args.instrument:
+        flags.append("--instrument-functions")
+    if args.coverage:
+        flags.append("--coverage")
+    if args.wrapv:
+        flags.append("--wrapv")
+    if args.stack_array_limit is not None:
+        flags.append(f"--stack-array-limit={args.stack_array_limit}")
+    if args.ast_cache:
+        flags.append(f"--ast-cache={args.filename}.ast")
+    if args.eval_steps is not None:
+        flags.append(f"--eval-steps={args.eval_steps}")
+    # Remarks point at Alan lines through the debug locations
+    remarks = []
+    if args.rpass:
+        remarks.append(f"-pass-remarks={args.rpass}")
+    if args.rpass_missed:
+        remarks.append(f"-pass-remarks-missed={args.rpass_missed}")
+    if args.rpass_analysis:
+        remarks.append(f"-pass-remarks-analysis={args.rpass_analysis}")
+    if (remarks or args.save_record) and not args.debug:
+        flags.append("-gline-tables-only")
+    record = os.path.splitext(args.filename)[0] + ".opt.yaml"
+    # Target options for the compiler and llc
+    targets = []
+    if args.target:
+        flags.append(f"--target={args.target}")
+        targets.append(f"-mtriple={args.target}")
+    if args.march:
+        flags.append(f"-march={args.march}")
+        targets.append("-mcpu=native")
+    elif args.mcpu:
+        flags.append(f"-mcpu={args.mcpu}")
+        targets.append(f"-mcpu={args.mcpu}")
+    # Separate compilation
+    for interface in module_interfaces(args.filenames):
+        flags.append(f"--import={interface}")
+    if args.dump_ast:
+        sp.run([compiler, *flags, f"--dump-ast={args.dump_ast}", args.filename])
+        cleanup(temp)
+        exit(0)
+    objects = [f for f in args.filenames if f.endswith(".o")]
+    if args.c:
+        obj = args.output
+        if obj is None:
+            obj = os.path.basename(args.filename).rpartition(".")[0] + ".o"
+        flags += ["--module", f"--interface={os.path.splitext(obj)[0]}.ali"]
+    llvm = compile_llvm(args.filename, compiler, temp, flags)
+    # Instrumentation passes must come before the -O pipeline
+    passes = []
+    link = []
+    if args.profile_generate:
+        passes += ["-pgo-instr-gen", "-instrprof"]
+        link.append("-fprofile-instr-generate")
+    if args.profile_use:
+        profile = merge_profile(args.profile_use, profdata, temp)
+        passes += ["-pgo-instr-use", f"-pgo-test-profile-file={profile}"]
+    passes.append(args.opts)
+    if args.jobs is not None and not args.L:
+        parts = split_module(llvm, split, count_partitions(llvm))
+        assemblies = compile_parallel(
+            parts,
+            opt,
+            llc,
+            passes,
+            temp,
+            args.jobs,
+            targets,
+            remarks,
+            args.save_record,
+        )
+        if args.save_record:
+            save_remarks(
+                [f"{p}.{s}.yaml" for p in parts for s in ("opt", "llc")],
+                record,
+            )
+        if args.S:
+            for assembly in assemblies:
+                with open(assembly, "r") as fp:
+                    print(fp.read())
+            cleanup(temp)
+            exit(0)
+        if args.c:
+            compile_object(assemblies, linker, obj)
+            cleanup(temp)
+            exit(0)
+        compile_executable(
+            assemblies + objects,
+            linker,
+            lib,
+            args.output or "a.out",
+            execs,
+            link,
+        )
+        cleanup(temp)
+        exit(0)
+    compile_optimizations(llvm, opt, passes, remarks, args.save_record, True)
+    if args.save_record and args.L:
+        save_remarks([f"{llvm}.opt.yaml"], record)
     if args.L:
         with open(llvm, "r") as fp:
             print(fp.read())
         cleanup(temp)
         exit(0)
-    assembly = compile_assembly(llvm, llc, temp)
+    assembly = compile_assembly(
+        llvm, llc, temp, targets, remarks, args.save_record
+    )
+    if args.save_record:
+        save_remarks([f"{llvm}.opt.yaml", f"{llvm}.llc.yaml"], record)
     if args.S:
         with open(assembly, "r") as fp:
             print(fp.read())
         cleanup(temp)
         exit(0)
-    compile_executable(assembly, linker, lib, args.output, execs)
+    if args.c:
+        compile_object([assembly], linker, obj)
+        cleanup(temp)
+        exit(0)
+    compile_executable(
+        [assembly] + objects, linker, lib, args.output or "a.out", execs, link
+    )
     cleanup(temp)
@@ -17,18 +17,38 @@
 #include <symbol/scope.hpp>
 #include <symbol/table.hpp>
 #include <ast/ast.hpp>
+#include <general/arena.hpp>
+#include <general/stack.hpp>
+#include <message/message.hpp>
+#include <options/options.hpp>
 #include <parser/parser.hpp>
 
 using namespace std;
 
-const char * filename;
+static const char *source;
 
-extern ast::astPtr parse();
+/**
+ * Runs on the compiler stack, diagnostics state is per thread
+ */
+static void compile() {
+    filename = source;
+    uint64_t key;
+    auto root = ast::loadCache(source, key);
+    if ( root == nullptr ) {
+        root = parse(source);
+        ast::semantic(root);
+        ast::writeCache(root, key);
+    }
+    ast::evaluate(root);
+    if ( options.dumpAst != DumpFormat::NONE )
+        ast::dump(root, options.dumpAst == DumpFormat::JSON);
+    else
+        ast::codegen(root);
+    arena.release();
+}
 
 int main(int argc, char *argv[]) {
-    filename = argv[1];
-    auto root = parse();
-    ast::semantic(root);
-    ast::codegen(root);
+    source = filename = parseOptions(argc, argv);
+    runWithStack(options.stackSize, compile);
     return 0;
 }
@@ -12,22 +12,51 @@
 
 #include <ast/ast.hpp>
 #include <general/general.hpp>
+#include <message/message.hpp>
+
+#include <cstring>
 
 namespace ast {
 
+/*******************************************************************************
+ ********************************* Node Store **********************************
+ *******************************************************************************/
+
+thread_local NodeStore *nodeStore = nullptr;
+
+/*******************************************************************************
+ * Runs when the arena is released. The chunks themselves belong to the
+ * arena, only the nodes that own something are destroyed here.
+ *******************************************************************************/
+NodeStore::~NodeStore() {
+    for ( auto& pool : this->pools ) {
+        if ( pool.destroy == nullptr )
+            continue;
+        for ( uint32_t i = 0; i < pool.count; i++ )
+            pool.destroy(pool.chunks[i >> CHUNK_BITS] + ( i & ( CHUNK - 1 ) ) * pool.size);
+    }
+    if ( nodeStore == this )
+        nodeStore = nullptr;
+}
+
+void NodeStore::tooMany() {
+    internal("Too many ast nodes of one kind");
+}
+
 /*******************************************************************************
  *********************************** General ***********************************
  *******************************************************************************/
 
-Node::Node() {
+Node::Node(NodeKind kind) {
     this->line = linecount;
+    this->kind = kind;
 }
 
 /*******************************************************************************
  ****************************** Integer Constants ******************************
  *******************************************************************************/
 
-Int::Int(int val) : Node() {
+Int::Int(int val) : Node(KIND) {
     this->type = sem::typeInteger;
     this->val  = val;
 }
@@ -36,7 +65,7 @@ Int::Int(int val) : Node() {
  ******************************* Byte Constants ********************************
  *******************************************************************************/
 
-Byte::Byte(unsigned char b) : Node() {
+Byte::Byte(unsigned char b) : Node(KIND) {
     this->type = sem::typeByte;
     this->b    = b;
 }
@@ -45,8 +74,8 @@ Byte::Byte(unsigned char b) : Node() {
  ******************************* String Literals *******************************
  *******************************************************************************/
 
-String::String(std::string s) : Node() {
-    this->type = newShared<sem::TypeArray>(s.size() + 1, sem::typeByte);
+String::String(const char *s) : Node(KIND) {
+    this->type = sem::typeArray(strlen(s) + 1, sem::typeByte);
     this->s    = s;
 }
 
@@ -54,7 +83,7 @@ String::String(std::string s) : Node() {
  ********************************** Variables **********************************
  *******************************************************************************/
 
-Var::Var(std::string id, astPtr index) : Node() {
+Var::Var(SymbolId id, astPtr index) : Node(KIND) {
     this->id    = id;
     this->index = index;
 }
@@ -63,7 +92,7 @@ Var::Var(std::string id, astPtr index) : Node() {
  ****************************** Binary Operators *******************************
  *******************************************************************************/
 
-BinOp::BinOp(char op, astPtr left, astPtr right) : Node() {
+BinOp::BinOp(char op, astPtr left, astPtr right) : Node(KIND) {
     this->op    = op;
     this->type  = left->type;
     this->left  = left;
@@ -74,7 +103,7 @@ BinOp::BinOp(char op, astPtr left, astPtr right) : Node() {
  ********************************* Conditions **********************************
  *******************************************************************************/
 
-Condition::Condition(Cond op, astPtr left, astPtr right) : Node() {
+Condition::Condition(Cond op, astPtr left, astPtr right) : Node(KIND) {
     this->type  = sem::typeByte;
     this->op    = op;
     this->left  = left;
@@ -85,7 +114,7 @@ Condition::Condition(Cond op, astPtr left, astPtr right) : Node() {
  *********************************** IfElse ************************************
  *******************************************************************************/
 
-IfElse::IfElse(astPtr cond, astPtr ifBody, astPtr elseBody) : Node() {
+IfElse::IfElse(astPtr cond, astPtr ifBody, astPtr elseBody) : Node(KIND) {
     this->cond     = cond;
     this->ifBody   = ifBody;
     this->elseBody = elseBody;
@@ -95,7 +124,7 @@ IfElse::IfElse(astPtr cond, astPtr ifBody, astPtr elseBody) : Node() {
  ************************************ While ************************************
  *******************************************************************************/
 
-While::While(astPtr cond, astPtr body) : Node() {
+While::While(astPtr cond, astPtr body) : Node(KIND) {
     this->cond = cond;
     this->body = body;
 }
@@ -104,7 +133,7 @@ While::While(astPtr cond, astPtr body) : Node() {
  ******************************** Function Call ********************************
  *******************************************************************************/
 
-Call::Call(std::string id, astVec params) : Node() {
+Call::Call(SymbolId id, astVec params) : Node(KIND) {
     this->id     = id;
     this->params = std::move(params);
 }
@@ -113,7 +142,7 @@ Call::Call(std::string id, astVec params) : Node() {
  ****************************** Function Returns *******************************
  *******************************************************************************/
 
-Ret::Ret(astPtr expr) : Node() {
+Ret::Ret(astPtr expr) : Node(KIND) {
     this->type = expr->type;
     this->expr = expr;
 }
@@ -122,7 +151,7 @@ Ret::Ret(astPtr expr) : Node() {
  ********************************* Assignments *********************************
  *******************************************************************************/
 
-Assign::Assign(astPtr left, astPtr right) : Node() {
+Assign::Assign(astPtr left, astPtr right) : Node(KIND) {
     this->type  = left->type;
     this->left  = left;
     this->right = right;
@@ -132,7 +161,7 @@ Assign::Assign(astPtr left, astPtr right) : Node() {
  **************************** Variable Declarations ****************************
  *******************************************************************************/
 
-VarDecl::VarDecl(std::string id, sem::TypePtr type) : Node() {
+VarDecl::VarDecl(SymbolId id, sem::TypePtr type) : Node(KIND) {
     this->type = type;
     this->id   = id;
 }
@@ -141,7 +170,7 @@ VarDecl::VarDecl(std::string id, sem::TypePtr type) : Node() {
  ********************************* Parameters **********************************
  *******************************************************************************/
 
-Param::Param(std::string id, sem::PassMode mode, sem::TypePtr type) : Node() {
+Param::Param(SymbolId id, sem::PassMode mode, sem::TypePtr type) : Node(KIND) {
     this->type = type;
     this->id   = id;
     this->mode = mode;
@@ -151,7 +180,7 @@ Param::Param(std::string id, sem::PassMode mode, sem::TypePtr type) : Node() {
  ********************************** Functions **********************************
  *******************************************************************************/
 
-Func::Func(std::string id, astVec params, sem::TypePtr type, astVec decls, astPtr body) : Node() {
+Func::Func(SymbolId id, astVec params, sem::TypePtr type, astVec decls, astPtr body) : Node(KIND) {
     this->type   = type;
     this->main   = false;
     this->id     = id;
@@ -164,7 +193,7 @@ Func::Func(std::string id, astVec params, sem::TypePtr type, astVec decls, astPt
  ***************************** Compound Statements *****************************
  *******************************************************************************/
 
-Block::Block(astVec stmts) : Node() {
+Block::Block(astVec stmts) : Node(KIND) {
     this->stmts = std::move(stmts);
 }
 
@@ -13,18 +13,24 @@
 #ifndef __AST_HPP__
 #define __AST_HPP__
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
 #include <llvm/IR/Value.h>
 
+#include <general/arena.hpp>
+#include <general/intern.hpp>
+
 #include <symbol/types.hpp>
 #include <symbol/entry.hpp>
 #include <symbol/table.hpp>
 
-extern int linecount;
-
 /*******************************************************************************
  * Alan AST or Abstract Syntax Tree
  * > Consists of a lot of different types of nodes :
@@ -37,6 +43,7 @@ extern int linecount;
  *   - Var -> variable ( e.g. in `x = 1`, x is the variable )
  *     > name
  *     > index ( null for normal variables, set for array variables )
+ *     > entry ( resolved by semantic analysis )
  *   - BinOp -> binary operator ( +, -, *, /, % )
  *     > operator
  *     > lhs ( maybe null )
@@ -56,6 +63,7 @@ extern int linecount;
  *     > name of function
  *     > normal parameters
  *     > hidden parameters ( i.e. needed -> check entry.hpp )
+ *     > entry ( resolved by semantic analysis )
  *   - Ret -> return statement
  *     > expression of the return stmt ( e.g. return x + 5 -> expr = x + 5 )
  *   - Assign -> variable assignment
@@ -63,37 +71,39 @@ extern int linecount;
  *     > rvalue
  *   - VarDecl -> variable declaration
  *     > name
+ *     > entry ( gives the slot of the variable )
  *   - Param -> typical parameter
  *     > name
  *     > mode ( by value or by reference )
+ *     > entry ( gives the slot of the parameter )
  *   - Func -> function
  *     > main -> bool to tell first function
  *     > name
+ *     > entry ( gives the slot of the function )
  *     > parameters
  *     > hidden parameters
  *     > declarations ( funcs and vars )
  *     > body ( statements )
  *   - Block -> compound statement
  *     > vector of statements
+ *
+ * Every node carries its NodeKind. Passes are dispatched with a switch on
+ * it ( check Node::semantic, Node::codegen, Node::fixCalls ) instead of
+ * virtual calls, and `nodeCast` replaces dynamic_cast. Nodes have no
+ * vtable.
+ *
+ * The ast is flat : nodes of each kind sit next to each other in a pool
+ * of their own ( check NodeStore ), and a node refers to its children
+ * with 32-bit NodeRefs instead of pointers.
  *******************************************************************************/
 
 namespace ast {
 
-/*******************************************************************************
- ********************************** Typedefs ***********************************
- *******************************************************************************/
-
-class Node;
-
-typedef std::shared_ptr<Node>                   astPtr;
-typedef std::vector<astPtr>                     astVec;
-typedef std::unordered_map<std::string, astVec> astVecMap;
-
 /*******************************************************************************
  *************************** Conditions enumeration ****************************
  *******************************************************************************/
 
-enum class Cond {
+enum class Cond : unsigned char {
     TRU,
     FALS,
     LT,
@@ -107,6 +117,28 @@ enum class Cond {
     NOT
 };
 
+/*******************************************************************************
+ *************************** Node kinds enumeration ****************************
+ *******************************************************************************/
+
+enum class NodeKind : unsigned char {
+    INT,
+    BYTE,
+    STRING,
+    VAR,
+    BINOP,
+    CONDITION,
+    IFELSE,
+    WHILE,
+    CALL,
+    RET,
+    ASSIGN,
+    VARDECL,
+    PARAM,
+    FUNC,
+    BLOCK
+};
+
 /*******************************************************************************
  ************************* Parent Class for All Nodes **************************
  *******************************************************************************/
@@ -115,29 +147,195 @@ class Node {
     public :
         sem::TypePtr type;
         int          line;
+        NodeKind     kind;
 
-        Node();
-        virtual ~Node() = default;
+        Node(NodeKind kind);
 
-        virtual void semantic(sem::SymbolTable symtable) = 0;
-        virtual llvm::Value* codegen() = 0;
+        /* Dispatch to the method of the node kind */
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 
-        virtual void fixCalls();
+        void fixCalls();
 };
 
+/*******************************************************************************
+ * NodeRef : a node as a 32-bit handle.
+ *   - The top 4 bits are its kind, the rest its index in the pool of that
+ *     kind. NONE is the null reference.
+ *   - `->` finds the node in the NodeStore of the thread, and
+ *     `static_cast<T *>(ref)` gives it as a T ( unchecked, as for
+ *     pointers ).
+ *   - Default construction leaves it uninitialized, so it can live in the
+ *     union of the parser.
+ *******************************************************************************/
+class NodeRef {
+    private :
+        uint32_t bits;
+    public :
+        static const uint32_t NONE       = 0xffffffff;
+        static const uint32_t KIND_SHIFT = 28;
+        static const uint32_t INDEX_MASK = ( 1u << KIND_SHIFT ) - 1;
+
+        NodeRef() = default;
+        NodeRef(std::nullptr_t) : bits(NONE) {}
+        NodeRef(NodeKind kind, uint32_t index)
+            : bits(( (uint32_t)kind << KIND_SHIFT ) | index) {}
+
+        NodeKind kind() const { return (NodeKind)( this->bits >> KIND_SHIFT ); }
+        uint32_t index() const { return this->bits & INDEX_MASK; }
+
+        Node* get() const;
+        Node* operator->() const { return this->get(); }
+
+        template<typename T>
+            explicit operator T*() const {
+                return static_cast<T *>(this->get());
+            }
+
+        explicit operator bool() const { return this->bits != NONE; }
+        bool operator==(std::nullptr_t) const { return this->bits == NONE; }
+        bool operator!=(std::nullptr_t) const { return this->bits != NONE; }
+        bool operator==(NodeRef other) const { return this->bits == other.bits; }
+        bool operator!=(NodeRef other) const { return this->bits != other.bits; }
+};
+
+/*******************************************************************************
+ * Reference to a node known to be a T ( what newNode returns ), so that
+ * its fields can be set before it is stored as a plain NodeRef.
+ *******************************************************************************/
+template<typename T>
+class NodeRefT : public NodeRef {
+    public :
+        explicit NodeRefT(uint32_t index) : NodeRef(T::KIND, index) {}
+
+        T* get() const { return static_cast<T *>(NodeRef::get()); }
+        T* operator->() const { return this->get(); }
+};
+
+/*******************************************************************************
+ ********************************** Typedefs ***********************************
+ *******************************************************************************/
+
+typedef NodeRef                                 astPtr;
+typedef std::vector<astPtr>                     astVec;
+
+/*******************************************************************************
+ * NodeStore : the nodes of one compilation.
+ *   - pools :
+ *     > One per kind. A pool is a list of chunks of CHUNK nodes of that
+ *     > kind, taken from the arena, so nodes never move and walking the
+ *     > nodes of a kind walks contiguous memory.
+ *   - It is created in the arena on the first node of a compilation, and
+ *   > destroyed ( running the destructors of the nodes that own symbol
+ *   > entries or vectors ) when the arena is released.
+ *******************************************************************************/
+class NodeStore {
+    private :
+        struct Pool {
+            std::vector<char *> chunks;
+            uint32_t            count   = 0;
+            uint32_t            size    = 0;
+            void              (*destroy)(void *) = nullptr;
+        };
+
+        static const uint32_t CHUNK_BITS = 9;
+        static const uint32_t CHUNK      = 1u << CHUNK_BITS;
+
+        /* One per value of the 4 kind bits, the last one stays empty */
+        Pool pools[16];
+
+        template<typename T>
+            static void destroy(void *obj) {
+                static_cast<T *>(obj)->~T();
+            }
+    public :
+        NodeStore() = default;
+        ~NodeStore();
+
+        NodeStore(const NodeStore&) = delete;
+        NodeStore& operator=(const NodeStore&) = delete;
+
+        Node* at(NodeRef ref) const {
+            const Pool &pool = this->pools[(int)ref.kind()];
+            uint32_t i = ref.index();
+            return reinterpret_cast<Node *>(pool.chunks[i >> CHUNK_BITS]
+                                            + ( i & ( CHUNK - 1 ) ) * pool.size);
+        }
+
+        template<typename T, typename ... Args>
+            NodeRefT<T> create(Args&& ... args) {
+                Pool &pool = this->pools[(int)T::KIND];
+                if ( pool.count > NodeRef::INDEX_MASK )
+                    tooMany();
+                if ( pool.count % CHUNK == 0 ) {
+                    pool.size = sizeof(T);
+                    if ( !std::is_trivially_destructible<T>::value )
+                        pool.destroy = &NodeStore::destroy<T>;
+                    pool.chunks.push_back(static_cast<char *>(arena.allocate(CHUNK * sizeof(T),
+                                                                             alignof(T))));
+                }
+                uint32_t index = pool.count;
+                new (pool.chunks.back() + ( index % CHUNK ) * sizeof(T))
+                    T(std::forward<Args>(args)...);
+                pool.count++;
+                return NodeRefT<T>(index);
+            }
+
+        static void tooMany();
+};
+
+/*******************************************************************************
+ * The nodes of the current compilation ( one per thread, like the arena,
+ * null until the first node ).
+ *******************************************************************************/
+extern thread_local NodeStore *nodeStore;
+
+inline Node* NodeRef::get() const {
+    return nodeStore->at(*this);
+}
+
+/*******************************************************************************
+ * Creates a node of kind T in its pool.
+ *******************************************************************************/
+template<typename T, typename ... Args>
+inline NodeRefT<T> newNode(Args&& ... args) {
+    if ( nodeStore == nullptr )
+        nodeStore = newArena<NodeStore>();
+    return nodeStore->create<T>(std::forward<Args>(args)...);
+}
+
+/*******************************************************************************
+ * Checked downcast : null unless `node` is a T.
+ * A reference is checked by its kind alone, without reaching the node.
+ *******************************************************************************/
+template<typename T>
+inline T* nodeCast(Node *node) {
+    if ( node == nullptr || node->kind != T::KIND )
+        return nullptr;
+    return static_cast<T *>(node);
+}
+
+template<typename T>
+inline T* nodeCast(NodeRef node) {
+    if ( node == nullptr || node.kind() != T::KIND )
+        return nullptr;
+    return static_cast<T *>(node);
+}
+
 /*******************************************************************************
  ****************************** Integer Constants ******************************
  *******************************************************************************/
 
 class Int : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::INT;
+
         int val;
 
         Int(int val);
-        virtual ~Int() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -146,13 +344,14 @@ class Int : public Node {
 
 class Byte : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::BYTE;
+
         unsigned char b;
 
         Byte(unsigned char b);
-        virtual ~Byte() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -161,13 +360,14 @@ class Byte : public Node {
 
 class String : public Node {
     public :
-        std::string s;
+        static constexpr NodeKind KIND = NodeKind::STRING;
+
+        const char *s;
 
-        String(std::string s);
-        virtual ~String() = default;
+        String(const char *s);
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -176,14 +376,16 @@ class String : public Node {
 
 class Var : public Node {
     public :
-        std::string id;
-        astPtr      index;
+        static constexpr NodeKind KIND = NodeKind::VAR;
 
-        Var(std::string id, astPtr index);
-        virtual ~Var() = default;
+        SymbolId      id;
+        astPtr        index;
+        sem::EntryPtr entry;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        Var(SymbolId id, astPtr index);
+
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -192,15 +394,16 @@ class Var : public Node {
 
 class BinOp : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::BINOP;
+
         char   op;
         astPtr left;
         astPtr right;
 
         BinOp(char op, astPtr left, astPtr right);
-        virtual ~BinOp() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -209,15 +412,16 @@ class BinOp : public Node {
 
 class Condition : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::CONDITION;
+
         Cond   op;
         astPtr left;
         astPtr right;
 
         Condition(Cond op, astPtr left, astPtr right);
-        virtual ~Condition() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -226,15 +430,16 @@ class Condition : public Node {
 
 class IfElse : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::IFELSE;
+
         astPtr cond;
         astPtr ifBody;
         astPtr elseBody;
 
         IfElse(astPtr cond, astPtr ifBody, astPtr elseBody);
-        virtual ~IfElse() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -243,14 +448,15 @@ class IfElse : public Node {
 
 class While : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::WHILE;
+
         astPtr cond;
         astPtr body;
 
         While(astPtr cond, astPtr body);
-        virtual ~While() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -259,17 +465,19 @@ class While : public Node {
 
 class Call : public Node {
     public :
-        std::string id;
-        astVec      params;
-        astVec      hidden;
+        static constexpr NodeKind KIND = NodeKind::CALL;
+
+        SymbolId      id;
+        astVec        params;
+        astVec        hidden;
+        sem::EntryPtr entry;
 
-        Call(std::string id, astVec params);
-        virtual ~Call() = default;
+        Call(SymbolId id, astVec params);
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 
-        void fixCalls() override;
+        void fixCalls();
 };
 
 /*******************************************************************************
@@ -278,13 +486,14 @@ class Call : public Node {
 
 class Ret : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::RET;
+
         astPtr expr;
 
         Ret(astPtr expr);
-        virtual ~Ret() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -293,14 +502,15 @@ class Ret : public Node {
 
 class Assign : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::ASSIGN;
+
         astPtr left;
         astPtr right;
 
         Assign(astPtr left, astPtr right);
-        virtual ~Assign() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -309,13 +519,15 @@ class Assign : public Node {
 
 class VarDecl : public Node {
     public :
-        std::string id;
+        static constexpr NodeKind KIND = NodeKind::VARDECL;
 
-        VarDecl(std::string id, sem::TypePtr type);
-        virtual ~VarDecl() = default;
+        SymbolId      id;
+        sem::EntryPtr entry;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        VarDecl(SymbolId id, sem::TypePtr type);
+
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -324,14 +536,16 @@ class VarDecl : public Node {
 
 class Param : public Node {
     public :
-        std::string   id;
+        static constexpr NodeKind KIND = NodeKind::PARAM;
+
+        SymbolId      id;
         sem::PassMode mode;
+        sem::EntryPtr entry;
 
-        Param(std::string id, sem::PassMode mode, sem::TypePtr type);
-        virtual ~Param() = default;
+        Param(SymbolId id, sem::PassMode mode, sem::TypePtr type);
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 };
 
 /*******************************************************************************
@@ -340,20 +554,24 @@ class Param : public Node {
 
 class Func : public Node {
     public :
-        std::string id;
-        bool        main;
-        astVec      params;
-        astVec      hidden;
-        astVec      decls;
-        astPtr      body;
+        static constexpr NodeKind KIND = NodeKind::FUNC;
+
+        SymbolId      id;
+        bool          main;
+        astVec        params;
+        astVec        hidden;
+        astVec        decls;
+        astPtr        body;
+        sem::EntryPtr entry;
+
+        Func(SymbolId id, astVec params, sem::TypePtr type, astVec decls, astPtr body);
 
-        Func(std::string id, astVec params, sem::TypePtr type, astVec decls, astPtr body);
-        virtual ~Func() = default;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void fixCalls();
 
-        void fixCalls() override;
+        sem::EntryPtr binding(SymbolId id);
 };
 
 /*******************************************************************************
@@ -362,15 +580,16 @@ class Func : public Node {
 
 class Block : public Node {
     public :
+        static constexpr NodeKind KIND = NodeKind::BLOCK;
+
         astVec stmts;
 
         Block(astVec stmts);
-        virtual ~Block() = default;
 
-        void semantic(sem::SymbolTable symtable) override;
-        llvm::Value* codegen() override;
+        void semantic(sem::Table &symtable);
+        llvm::Value* codegen();
 
-        void fixCalls() override;
+        void fixCalls();
 };
 
 /*******************************************************************************
@@ -378,7 +597,16 @@ class Block : public Node {
  *******************************************************************************/
 
 void semantic(astPtr root);
+void evaluate(astPtr root);
 void codegen(astPtr root);
+void dump(astPtr root, bool json);
+
+/*******************************************************************************
+ * Checked ast cache ( --ast-cache, check cache.cpp ).
+ *   - loadCache returns null on a miss, `key` is what writeCache stores.
+ *******************************************************************************/
+astPtr loadCache(const char *source, uint64_t &key);
+void writeCache(astPtr root, uint64_t key);
 
 } // namespace ast end
 
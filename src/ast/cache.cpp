@@ -0,0 +1,715 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : cache.cpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Binary cache of the checked ast                              *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ast/ast.hpp>
+#include <general/arena.hpp>
+#include <general/general.hpp>
+#include <general/mapped.hpp>
+#include <message/message.hpp>
+#include <options/options.hpp>
+#include <symbol/interface.hpp>
+
+/*******************************************************************************
+ * Ast cache ( --ast-cache=FILE ) :
+ *   - After semantic analysis the ast is written to FILE, with its types,
+ *   > symbol entries ( slots, modes, resolved hidden parameters ) and line
+ *   > numbers. The next compilation of the same source maps FILE and builds
+ *   > the ast from it, skipping lexing, parsing and semantic analysis.
+ *   - FILE is only used if its key matches : a hash of the source, of
+ *   > every imported interface ( they decide the slots of imported
+ *   > functions ) and of the options the checked ast goes with ( --module,
+ *   > --interface ). Otherwise it is rewritten.
+ *   - Format ( 32-bit words, host byte order ) :
+ *     > header  : magic, version, key ( 2 words ), #strings, #types,
+ *     >           #entries, #words of the whole file
+ *     > strings : length, bytes ( '\0' terminated, padded to a word )
+ *     > types   : genType, size, ref
+ *     > entries : kind, name, type, slot
+ *     >           + mode                                ( parameters )
+ *     >           + recursive, #params, params,
+ *     >             #hidden, hidden                     ( functions )
+ *     > nodes   : the root, preorder ( check CacheWriter::node )
+ *   - Every table only refers to earlier ones and entries to earlier
+ *   > entries, so the file is read front to back. String literals of the
+ *   > ast point into the mapping.
+ *   - Every read is checked against the file, so a damaged cache is just
+ *   > a miss.
+ *******************************************************************************/
+
+namespace ast {
+
+static const uint32_t CACHE_MAGIC   = 0x4e4c4141;   // "AALN"
+static const uint32_t CACHE_VERSION = 1;
+static const uint32_t NONE          = 0xffffffff;
+
+/*******************************************************************************
+ ************************************* Key *************************************
+ *******************************************************************************/
+
+/*******************************************************************************
+ * FNV-1a
+ *******************************************************************************/
+static uint64_t hashBytes(uint64_t h, const char *data, std::size_t size) {
+    for ( std::size_t i = 0; i < size; i++ ) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static uint64_t hashString(uint64_t h, const std::string &s) {
+    return hashBytes(h, s.c_str(), s.size() + 1);
+}
+
+/*******************************************************************************
+ * The source is hashed through the mapping the mmap lexer scans afterwards.
+ *******************************************************************************/
+static bool hashFile(uint64_t &h, const char *path, bool source) {
+    char *data;
+    std::size_t size;
+    if ( !( source ? mapSource(path, data, size) : mapFile(path, false, data, size) ) )
+        return false;
+    h = hashBytes(h, path, strlen(path) + 1);
+    h = hashBytes(h, data, size);
+    return true;
+}
+
+/*******************************************************************************
+ ************************************ Writing **********************************
+ *******************************************************************************/
+
+class CacheWriter {
+    private :
+        std::vector<uint32_t> strings;
+        std::vector<uint32_t> types;
+        std::vector<uint32_t> entries;
+        std::vector<uint32_t> nodes;
+        uint32_t stringCount = 0;
+        uint32_t typeCount   = 0;
+        uint32_t entryCount  = 0;
+
+        std::unordered_map<std::string, uint32_t> stringIds;
+        std::unordered_map<sem::Type *, uint32_t> typeIds;
+        std::unordered_map<sem::Entry *, uint32_t> entryIds;
+
+        uint32_t string(const std::string &s);
+        uint32_t type(sem::TypePtr t);
+        uint32_t entry(const sem::EntryPtr &e);
+        void nodeList(const astVec &list);
+    public :
+        void node(astPtr n);
+        bool write(const char *path, uint64_t key);
+};
+
+uint32_t CacheWriter::string(const std::string &s) {
+    auto found = this->stringIds.find(s);
+    if ( found != this->stringIds.end() )
+        return found->second;
+    this->strings.push_back(s.size());
+    std::size_t words = s.size() / 4 + 1;
+    std::size_t at = this->strings.size();
+    this->strings.resize(at + words, 0);
+    memcpy(&this->strings[at], s.data(), s.size());
+    this->stringIds.emplace(s, this->stringCount);
+    return this->stringCount++;
+}
+
+uint32_t CacheWriter::type(sem::TypePtr t) {
+    if ( t == nullptr )
+        return NONE;
+    auto found = this->typeIds.find(t);
+    if ( found != this->typeIds.end() )
+        return found->second;
+    uint32_t size = 0;
+    uint32_t ref  = NONE;
+    if ( t->t == sem::genType::ARRAY || t->t == sem::genType::IARRAY )
+        ref = this->type(t->getRef());
+    if ( t->t == sem::genType::ARRAY )
+        size = t->getSize();
+    this->types.push_back((uint32_t)t->t);
+    this->types.push_back(size);
+    this->types.push_back(ref);
+    this->typeIds.emplace(t, this->typeCount);
+    return this->typeCount++;
+}
+
+/**
+ * Parameters and hidden entries of a function are
+ * written before it, so that it only refers back
+ */
+uint32_t CacheWriter::entry(const sem::EntryPtr &e) {
+    auto found = this->entryIds.find(e.get());
+    if ( found != this->entryIds.end() )
+        return found->second;
+    uint32_t name = this->string(symbolName(e->id));
+    uint32_t type = this->type(e->type);
+    std::vector<uint32_t> params, hidden;
+    if ( e->eType == sem::EntryType::FUNCTION ) {
+        for ( auto& p : e->getParams() )
+            params.push_back(this->entry(p));
+        for ( auto& h : e->getHidden() )
+            hidden.push_back(this->entry(h));
+    }
+    this->entries.push_back((uint32_t)e->eType);
+    this->entries.push_back(name);
+    this->entries.push_back(type);
+    this->entries.push_back(e->getOffset());
+    switch ( e->eType ) {
+        case sem::EntryType::PARAMETER :
+            this->entries.push_back((uint32_t)e->getMode());
+            break;
+        case sem::EntryType::FUNCTION :
+            this->entries.push_back(e->isRecursive());
+            this->entries.push_back(params.size());
+            this->entries.insert(this->entries.end(), params.begin(), params.end());
+            this->entries.push_back(hidden.size());
+            this->entries.insert(this->entries.end(), hidden.begin(), hidden.end());
+            break;
+        default :
+            break;
+    }
+    this->entryIds.emplace(e.get(), this->entryCount);
+    return this->entryCount++;
+}
+
+void CacheWriter::nodeList(const astVec &list) {
+    this->nodes.push_back(list.size());
+    for ( auto n : list )
+        this->node(n);
+}
+
+/*******************************************************************************
+ * A node is : kind, line, type ( NONE for statements ), then its fields and
+ * children in the order of its constructor. Missing children are NONE.
+ *******************************************************************************/
+void CacheWriter::node(astPtr n) {
+    if ( n == nullptr ) {
+        this->nodes.push_back(NONE);
+        return;
+    }
+    bool statement = n->kind == NodeKind::IFELSE || n->kind == NodeKind::WHILE
+                  || n->kind == NodeKind::BLOCK;
+    this->nodes.push_back((uint32_t)n->kind);
+    this->nodes.push_back(n->line);
+    this->nodes.push_back(statement ? NONE : this->type(n->type));
+    switch ( n->kind ) {
+        case NodeKind::INT :
+            this->nodes.push_back(static_cast<Int *>(n)->val);
+            return;
+        case NodeKind::BYTE :
+            this->nodes.push_back(static_cast<Byte *>(n)->b);
+            return;
+        case NodeKind::STRING :
+            this->nodes.push_back(this->string(static_cast<String *>(n)->s));
+            return;
+        case NodeKind::VAR : {
+            auto v = static_cast<Var *>(n);
+            this->nodes.push_back(this->string(symbolName(v->id)));
+            this->nodes.push_back(this->entry(v->entry));
+            this->node(v->index);
+            return;
+        }
+        case NodeKind::BINOP : {
+            auto b = static_cast<BinOp *>(n);
+            this->nodes.push_back(b->op);
+            this->node(b->left);
+            this->node(b->right);
+            return;
+        }
+        case NodeKind::CONDITION : {
+            auto c = static_cast<Condition *>(n);
+            this->nodes.push_back((uint32_t)c->op);
+            this->node(c->left);
+            this->node(c->right);
+            return;
+        }
+        case NodeKind::IFELSE : {
+            auto i = static_cast<IfElse *>(n);
+            this->node(i->cond);
+            this->node(i->ifBody);
+            this->node(i->elseBody);
+            return;
+        }
+        case NodeKind::WHILE :
+            this->node(static_cast<While *>(n)->cond);
+            this->node(static_cast<While *>(n)->body);
+            return;
+        case NodeKind::CALL : {
+            auto c = static_cast<Call *>(n);
+            this->nodes.push_back(this->string(symbolName(c->id)));
+            this->nodes.push_back(this->entry(c->entry));
+            this->nodeList(c->params);
+            this->nodeList(c->hidden);
+            return;
+        }
+        case NodeKind::RET :
+            this->node(static_cast<Ret *>(n)->expr);
+            return;
+        case NodeKind::ASSIGN :
+            this->node(static_cast<Assign *>(n)->left);
+            this->node(static_cast<Assign *>(n)->right);
+            return;
+        case NodeKind::VARDECL : {
+            auto v = static_cast<VarDecl *>(n);
+            this->nodes.push_back(this->string(symbolName(v->id)));
+            this->nodes.push_back(this->entry(v->entry));
+            return;
+        }
+        case NodeKind::PARAM : {
+            auto p = static_cast<Param *>(n);
+            this->nodes.push_back(this->string(symbolName(p->id)));
+            this->nodes.push_back((uint32_t)p->mode);
+            this->nodes.push_back(this->entry(p->entry));
+            return;
+        }
+        case NodeKind::FUNC : {
+            auto f = static_cast<Func *>(n);
+            this->nodes.push_back(this->string(symbolName(f->id)));
+            this->nodes.push_back(f->main);
+            this->nodes.push_back(this->entry(f->entry));
+            this->nodeList(f->params);
+            this->nodeList(f->hidden);
+            this->nodeList(f->decls);
+            this->node(f->body);
+            return;
+        }
+        case NodeKind::BLOCK :
+            this->nodeList(static_cast<Block *>(n)->stmts);
+            return;
+    }
+}
+
+/**
+ * Written next to FILE and renamed over it,
+ * so a concurrent compilation never maps half a cache
+ */
+bool CacheWriter::write(const char *path, uint64_t key) {
+    std::vector<uint32_t> header = {
+        CACHE_MAGIC, CACHE_VERSION, (uint32_t)key, (uint32_t)( key >> 32 ),
+        this->stringCount, this->typeCount, this->entryCount, 0
+    };
+    header[7] = header.size() + this->strings.size() + this->types.size()
+              + this->entries.size() + this->nodes.size();
+    std::string temp = std::string(path) + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temp, std::ios::binary);
+        for ( auto *part : { &header, &this->strings, &this->types, &this->entries, &this->nodes } )
+            out.write(reinterpret_cast<const char *>(part->data()), part->size() * sizeof(uint32_t));
+        if ( !out )
+            return false;
+    }
+    if ( rename(temp.c_str(), path) != 0 ) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ ************************************ Reading **********************************
+ *******************************************************************************/
+
+class CacheReader {
+    private :
+        const uint32_t *cur;
+        const uint32_t *end;
+        bool            ok = true;
+
+        std::vector<const char *>   strings;
+        std::vector<SymbolId>       ids;
+        std::vector<sem::TypePtr>   types;
+        std::vector<sem::EntryPtr>  entries;
+
+        uint32_t word() {
+            if ( this->cur == this->end ) {
+                this->ok = false;
+                return 0;
+            }
+            return *this->cur++;
+        }
+        /* An index below `limit` ( or NONE if allowed ) */
+        uint32_t index(std::size_t limit, bool none = false) {
+            uint32_t i = this->word();
+            if ( i == NONE && none )
+                return i;
+            if ( i >= limit ) {
+                this->ok = false;
+                return 0;
+            }
+            return i;
+        }
+        const char* string();
+        SymbolId name();
+        sem::TypePtr type();
+        sem::EntryPtr entry();
+        astVec nodeList();
+
+        bool readStrings(uint32_t count);
+        bool readTypes(uint32_t count);
+        bool readEntries(uint32_t count);
+    public :
+        astPtr node();
+        astPtr read(const char *data, std::size_t size, uint64_t key);
+};
+
+const char* CacheReader::string() {
+    if ( this->strings.empty() ) {
+        this->ok = false;
+        return "";
+    }
+    return this->strings[this->index(this->strings.size())];
+}
+
+/**
+ * Names are interned the first time they are used,
+ * string literals are never interned
+ */
+SymbolId CacheReader::name() {
+    if ( this->strings.empty() ) {
+        this->ok = false;
+        return 0;
+    }
+    uint32_t i = this->index(this->strings.size());
+    if ( this->ids[i] == NONE )
+        this->ids[i] = intern(this->strings[i]);
+    return this->ids[i];
+}
+
+sem::TypePtr CacheReader::type() {
+    uint32_t i = this->index(this->types.size(), true);
+    return i == NONE || !this->ok ? nullptr : this->types[i];
+}
+
+sem::EntryPtr CacheReader::entry() {
+    uint32_t i = this->index(this->entries.size());
+    return this->ok ? this->entries[i] : nullptr;
+}
+
+bool CacheReader::readStrings(uint32_t count) {
+    for ( uint32_t i = 0; i < count && this->ok; i++ ) {
+        uint32_t length = this->word();
+        std::size_t words = length / 4 + 1;
+        if ( words > (std::size_t)( this->end - this->cur ) )
+            return false;
+        auto s = reinterpret_cast<const char *>(this->cur);
+        if ( s[length] != '\0' )
+            return false;
+        this->strings.push_back(s);
+        this->cur += words;
+    }
+    this->ids.assign(this->strings.size(), NONE);
+    return this->ok;
+}
+
+bool CacheReader::readTypes(uint32_t count) {
+    for ( uint32_t i = 0; i < count && this->ok; i++ ) {
+        uint32_t t    = this->word();
+        uint32_t size = this->word();
+        uint32_t ref  = this->index(this->types.size(), true);
+        sem::TypePtr type = nullptr;
+        switch ( (sem::genType)t ) {
+            case sem::genType::VOID :
+                type = sem::typeVoid;
+                break;
+            case sem::genType::INT :
+                type = sem::typeInteger;
+                break;
+            case sem::genType::BYTE :
+                type = sem::typeByte;
+                break;
+            case sem::genType::ARRAY :
+                if ( ref != NONE && this->ok )
+                    type = sem::typeArray(size, this->types[ref]);
+                break;
+            case sem::genType::IARRAY :
+                if ( ref != NONE && this->ok )
+                    type = sem::typeIArray(this->types[ref]);
+                break;
+        }
+        if ( type == nullptr )
+            return false;
+        this->types.push_back(type);
+    }
+    return this->ok;
+}
+
+bool CacheReader::readEntries(uint32_t count) {
+    for ( uint32_t i = 0; i < count && this->ok; i++ ) {
+        uint32_t kind    = this->word();
+        SymbolId id      = this->name();
+        sem::TypePtr ty  = this->type();
+        int slot         = this->word();
+        if ( !this->ok )
+            return false;
+        sem::EntryPtr e;
+        switch ( (sem::EntryType)kind ) {
+            case sem::EntryType::VARIABLE :
+                e = newShared<sem::EntryVariable>(id, ty);
+                break;
+            case sem::EntryType::PARAMETER : {
+                uint32_t mode = this->word();
+                if ( mode > (uint32_t)sem::PassMode::REFERENCE )
+                    return false;
+                e = newShared<sem::EntryParameter>(id, ty, (sem::PassMode)mode);
+                break;
+            }
+            case sem::EntryType::FUNCTION : {
+                auto f = newShared<sem::EntryFunction>(id, ty);
+                f->recursive = this->word() != 0;
+                for ( uint32_t n = this->word(); n > 0 && this->ok; n-- )
+                    f->addParam(this->entry());
+                for ( uint32_t n = this->word(); n > 0 && this->ok; n-- )
+                    f->addHidden(this->entry());
+                e = f;
+                break;
+            }
+            default :
+                return false;
+        }
+        e->setOffset(slot);
+        this->entries.push_back(e);
+    }
+    return this->ok;
+}
+
+astVec CacheReader::nodeList() {
+    astVec list;
+    uint32_t n = this->word();
+    if ( n > (std::size_t)( this->end - this->cur ) ) {
+        this->ok = false;
+        return list;
+    }
+    list.reserve(n);
+    for ( uint32_t i = 0; i < n && this->ok; i++ )
+        list.push_back(this->node());
+    return list;
+}
+
+/*******************************************************************************
+ * Inverse of CacheWriter::node. Children are read before their parent is
+ * built, since the constructors take them.
+ *******************************************************************************/
+astPtr CacheReader::node() {
+    uint32_t kind = this->word();
+    if ( kind == NONE || !this->ok )
+        return nullptr;
+    if ( kind > (uint32_t)NodeKind::BLOCK ) {
+        this->ok = false;
+        return nullptr;
+    }
+    int line          = this->word();
+    sem::TypePtr type = this->type();
+    astPtr n = nullptr;
+    switch ( (NodeKind)kind ) {
+        case NodeKind::INT :
+            n = newNode<Int>((int)this->word());
+            break;
+        case NodeKind::BYTE :
+            n = newNode<Byte>((unsigned char)this->word());
+            break;
+        case NodeKind::STRING :
+            n = newNode<String>(this->string());
+            break;
+        case NodeKind::VAR : {
+            SymbolId id = this->name();
+            auto entry  = this->entry();
+            auto v      = newNode<Var>(id, this->node());
+            v->entry    = entry;
+            n = v;
+            break;
+        }
+        case NodeKind::BINOP : {
+            char op    = this->word();
+            auto left  = this->node();
+            auto right = this->node();
+            if ( left == nullptr || right == nullptr )
+                break;
+            n = newNode<BinOp>(op, left, right);
+            break;
+        }
+        case NodeKind::CONDITION : {
+            uint32_t op = this->word();
+            auto left   = this->node();
+            auto right  = this->node();
+            if ( op > (uint32_t)Cond::NOT )
+                break;
+            n = newNode<Condition>((Cond)op, left, right);
+            break;
+        }
+        case NodeKind::IFELSE : {
+            auto cond     = this->node();
+            auto ifBody   = this->node();
+            auto elseBody = this->node();
+            n = newNode<IfElse>(cond, ifBody, elseBody);
+            break;
+        }
+        case NodeKind::WHILE : {
+            auto cond = this->node();
+            auto body = this->node();
+            n = newNode<While>(cond, body);
+            break;
+        }
+        case NodeKind::CALL : {
+            SymbolId id = this->name();
+            auto entry  = this->entry();
+            auto c      = newNode<Call>(id, this->nodeList());
+            c->hidden   = this->nodeList();
+            c->entry    = entry;
+            n = c;
+            break;
+        }
+        case NodeKind::RET : {
+            auto expr = this->node();
+            if ( expr == nullptr )
+                break;
+            n = newNode<Ret>(expr);
+            break;
+        }
+        case NodeKind::ASSIGN : {
+            auto left  = this->node();
+            auto right = this->node();
+            if ( left == nullptr || right == nullptr )
+                break;
+            n = newNode<Assign>(left, right);
+            break;
+        }
+        case NodeKind::VARDECL : {
+            SymbolId id = this->name();
+            auto v      = newNode<VarDecl>(id, type);
+            v->entry    = this->entry();
+            n = v;
+            break;
+        }
+        case NodeKind::PARAM : {
+            SymbolId id   = this->name();
+            uint32_t mode = this->word();
+            if ( mode > (uint32_t)sem::PassMode::REFERENCE )
+                break;
+            auto p   = newNode<Param>(id, (sem::PassMode)mode, type);
+            p->entry = this->entry();
+            n = p;
+            break;
+        }
+        case NodeKind::FUNC : {
+            SymbolId id  = this->name();
+            bool main    = this->word() != 0;
+            auto entry   = this->entry();
+            auto params  = this->nodeList();
+            auto hidden  = this->nodeList();
+            auto decls   = this->nodeList();
+            auto body    = this->node();
+            auto f       = newNode<Func>(id, std::move(params), type, std::move(decls), body);
+            f->hidden    = std::move(hidden);
+            f->main      = main;
+            f->entry     = entry;
+            n = f;
+            break;
+        }
+        case NodeKind::BLOCK :
+            n = newNode<Block>(this->nodeList());
+            break;
+    }
+    if ( n == nullptr || !this->ok ) {
+        this->ok = false;
+        return nullptr;
+    }
+    n->line = line;
+    n->type = type;
+    return n;
+}
+
+astPtr CacheReader::read(const char *data, std::size_t size, uint64_t key) {
+    if ( size % sizeof(uint32_t) != 0 || size < 8 * sizeof(uint32_t) )
+        return nullptr;
+    this->cur = reinterpret_cast<const uint32_t *>(data);
+    this->end = this->cur + size / sizeof(uint32_t);
+    const uint32_t *h = this->cur;
+    if ( h[0] != CACHE_MAGIC || h[1] != CACHE_VERSION
+            || h[2] != (uint32_t)key || h[3] != (uint32_t)( key >> 32 )
+            || h[7] != size / sizeof(uint32_t) )
+        return nullptr;
+    this->cur += 8;
+    if ( !this->readStrings(h[4]) || !this->readTypes(h[5]) || !this->readEntries(h[6]) )
+        return nullptr;
+    astPtr root = this->node();
+    if ( !this->ok || this->cur != this->end || nodeCast<Func>(root) == nullptr )
+        return nullptr;
+    return root;
+}
+
+/*******************************************************************************
+ ********************************** Interface **********************************
+ *******************************************************************************/
+
+/*******************************************************************************
+ * Key of a source file, its imports and options ( false if a file cannot
+ * be read ).
+ *******************************************************************************/
+static bool cacheKey(const char *source, uint64_t &key) {
+    key = 0xcbf29ce484222325ull;
+    key = hashBytes(key, reinterpret_cast<const char *>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+    key = hashString(key, options.module ? "module" : "program");
+    key = hashString(key, options.interface);
+    if ( !hashFile(key, source, true) )
+        return false;
+    for ( auto& path : options.imports )
+        if ( !hashFile(key, path.c_str(), false) )
+            return false;
+    return true;
+}
+
+/*******************************************************************************
+ * Everything semantic analysis does besides checking the ast is redone :
+ * imported functions are loaded for codegen and the interface is written.
+ *******************************************************************************/
+astPtr loadCache(const char *source, uint64_t &key) {
+    key = 0;
+    uint64_t sourceKey;
+    if ( options.astCache.empty() || source == nullptr || !cacheKey(source, sourceKey) )
+        return nullptr;
+    key = sourceKey;
+    char *data;
+    std::size_t size;
+    if ( !mapFile(options.astCache.c_str(), false, data, size) || data == nullptr )
+        return nullptr;
+    CacheReader reader;
+    astPtr root = reader.read(data, size, key);
+    if ( root == nullptr )
+        return nullptr;
+    sem::initSymbolTable();
+    if ( !options.interface.empty() ) {
+        auto *program = static_cast<Func *>(root);
+        sem::writeInterface(options.interface.c_str(), program->entry);
+    }
+    return root;
+}
+
+void writeCache(astPtr root, uint64_t key) {
+    if ( options.astCache.empty() || key == 0 )
+        return;
+    CacheWriter writer;
+    writer.node(root);
+    if ( !writer.write(options.astCache.c_str(), key) )
+        warning("Cannot write ast cache ", options.astCache);
+}
+
+} // end namespace ast
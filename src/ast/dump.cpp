@@ -0,0 +1,376 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : dump.cpp                                                     *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Printing of the checked ast ( --dump-ast )                   *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <ast/ast.hpp>
+
+/*******************************************************************************
+ * The ast is printed after semantic analysis, so every node shows its type
+ * and every name the slot it was bound to. Functions and calls also show
+ * their hidden parameters / arguments.
+ *   - text : one node per line, children indented with "| "
+ *   - json : one object per node, { "kind" : ..., fields, children }
+ * Nothing here runs unless --dump-ast is given.
+ *******************************************************************************/
+
+namespace ast {
+
+static const char *condNames[] = {
+    "true", "false", "<", ">", "<=", ">=", "==", "!=", "&", "|", "!"
+};
+
+static std::string typeName(sem::TypePtr type) {
+    if ( type == nullptr )
+        return "none";
+    std::ostringstream out;
+    out << *type;
+    return out.str();
+}
+
+/*******************************************************************************
+ * Escapes like the json string rules, so that a text line is one node.
+ *******************************************************************************/
+static std::string escape(const std::string &s) {
+    std::string out;
+    for ( unsigned char c : s ) {
+        switch ( c ) {
+            case '"'  : out += "\\\""; break;
+            case '\\' : out += "\\\\"; break;
+            case '\n' : out += "\\n";  break;
+            case '\t' : out += "\\t";  break;
+            case '\r' : out += "\\r";  break;
+            default :
+                if ( c < 0x20 || c >= 0x7f ) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+static const char* modeName(sem::PassMode mode) {
+    return mode == sem::PassMode::REFERENCE ? "reference" : "value";
+}
+
+static int slotOf(const sem::EntryPtr &entry) {
+    return entry == nullptr ? -1 : entry->getOffset();
+}
+
+/*******************************************************************************
+ ************************************ Text *************************************
+ *******************************************************************************/
+
+class TextDumper {
+    private :
+        std::ostream &out;
+        unsigned int  level = 0;
+
+        template<typename ... Args>
+            void line(Args&& ... args) {
+                for ( unsigned int i = 0; i < this->level; i++ )
+                    this->out << "| ";
+                (this->out << ... << args) << std::endl;
+            }
+        void children(const astVec &nodes) {
+            for ( auto n : nodes )
+                this->dump(n);
+        }
+    public :
+        TextDumper(std::ostream &out) : out(out) {  }
+
+        void dump(astPtr node) {
+            if ( node == nullptr )
+                return;
+            switch ( node->kind ) {
+                case NodeKind::INT :
+                    line("<Integer, ", static_cast<Int *>(node)->val, ">");
+                    return;
+                case NodeKind::BYTE :
+                    line("<Byte, ", (int)static_cast<Byte *>(node)->b, ">");
+                    return;
+                case NodeKind::STRING :
+                    line("<String Literal, \"", escape(static_cast<String *>(node)->s), "\", ", typeName(node->type), ">");
+                    return;
+                case NodeKind::VAR : {
+                    auto v = static_cast<Var *>(node);
+                    line("<Var, ", symbolName(v->id), ", ", typeName(v->type), ", slot ", slotOf(v->entry), ">");
+                    break;
+                }
+                case NodeKind::BINOP :
+                    line("<BinOp, ", static_cast<BinOp *>(node)->op, ", ", typeName(node->type), ">");
+                    break;
+                case NodeKind::CONDITION :
+                    line("<Condition, ", condNames[(int)static_cast<Condition *>(node)->op], ">");
+                    break;
+                case NodeKind::IFELSE :
+                    line("<IfElse>");
+                    break;
+                case NodeKind::WHILE :
+                    line("<While>");
+                    break;
+                case NodeKind::CALL : {
+                    auto c = static_cast<Call *>(node);
+                    line("<FunctionCall, ", symbolName(c->id), ", ", typeName(c->type), ", slot ", slotOf(c->entry), ">");
+                    break;
+                }
+                case NodeKind::RET :
+                    line("<Return, ", typeName(node->type), ">");
+                    break;
+                case NodeKind::ASSIGN :
+                    line("<Assignment, ", typeName(node->type), ">");
+                    break;
+                case NodeKind::VARDECL : {
+                    auto v = static_cast<VarDecl *>(node);
+                    line("<VarDecl, ", symbolName(v->id), ", ", typeName(v->type), ", slot ", slotOf(v->entry), ">");
+                    return;
+                }
+                case NodeKind::PARAM : {
+                    auto p = static_cast<Param *>(node);
+                    line("<Parameter, ", symbolName(p->id), ", ", typeName(p->type), ", ", modeName(p->mode), ", slot ", slotOf(p->entry), ">");
+                    return;
+                }
+                case NodeKind::FUNC : {
+                    auto f = static_cast<Func *>(node);
+                    line("<Function Declaration, ", symbolName(f->id), ", ", typeName(f->type), ", slot ", slotOf(f->entry), ">");
+                    break;
+                }
+                case NodeKind::BLOCK :
+                    line("<Block Statement>");
+                    break;
+            }
+            this->level++;
+            switch ( node->kind ) {
+                case NodeKind::VAR :
+                    this->dump(static_cast<Var *>(node)->index);
+                    break;
+                case NodeKind::BINOP :
+                    this->dump(static_cast<BinOp *>(node)->left);
+                    this->dump(static_cast<BinOp *>(node)->right);
+                    break;
+                case NodeKind::CONDITION :
+                    this->dump(static_cast<Condition *>(node)->left);
+                    this->dump(static_cast<Condition *>(node)->right);
+                    break;
+                case NodeKind::IFELSE :
+                    this->dump(static_cast<IfElse *>(node)->cond);
+                    this->dump(static_cast<IfElse *>(node)->ifBody);
+                    this->dump(static_cast<IfElse *>(node)->elseBody);
+                    break;
+                case NodeKind::WHILE :
+                    this->dump(static_cast<While *>(node)->cond);
+                    this->dump(static_cast<While *>(node)->body);
+                    break;
+                case NodeKind::CALL :
+                    this->children(static_cast<Call *>(node)->params);
+                    if ( !static_cast<Call *>(node)->hidden.empty() ) {
+                        line("<Hidden Arguments>");
+                        this->level++;
+                        this->children(static_cast<Call *>(node)->hidden);
+                        this->level--;
+                    }
+                    break;
+                case NodeKind::RET :
+                    this->dump(static_cast<Ret *>(node)->expr);
+                    break;
+                case NodeKind::ASSIGN :
+                    this->dump(static_cast<Assign *>(node)->left);
+                    this->dump(static_cast<Assign *>(node)->right);
+                    break;
+                case NodeKind::FUNC : {
+                    auto f = static_cast<Func *>(node);
+                    this->children(f->params);
+                    if ( !f->hidden.empty() ) {
+                        line("<Hidden Parameters>");
+                        this->level++;
+                        this->children(f->hidden);
+                        this->level--;
+                    }
+                    this->children(f->decls);
+                    this->dump(f->body);
+                    break;
+                }
+                case NodeKind::BLOCK :
+                    this->children(static_cast<Block *>(node)->stmts);
+                    break;
+                default :
+                    break;
+            }
+            this->level--;
+        }
+};
+
+/*******************************************************************************
+ ************************************ JSON *************************************
+ *******************************************************************************/
+
+class JsonDumper {
+    private :
+        std::ostream &out;
+
+        void string(const std::string &s) {
+            this->out << '"' << escape(s) << '"';
+        }
+        void key(const char *name) {
+            this->out << ", ";
+            this->string(name);
+            this->out << ": ";
+        }
+        void field(const char *name, const std::string &value) {
+            this->key(name);
+            this->string(value);
+        }
+        void field(const char *name, long long value) {
+            this->key(name);
+            this->out << value;
+        }
+        void child(const char *name, astPtr node) {
+            this->key(name);
+            this->dump(node);
+        }
+        void children(const char *name, const astVec &nodes) {
+            this->key(name);
+            this->out << "[";
+            for ( std::size_t i = 0; i < nodes.size(); i++ ) {
+                if ( i > 0 )
+                    this->out << ", ";
+                this->dump(nodes[i]);
+            }
+            this->out << "]";
+        }
+    public :
+        JsonDumper(std::ostream &out) : out(out) {  }
+
+        void dump(astPtr node) {
+            if ( node == nullptr ) {
+                this->out << "null";
+                return;
+            }
+            static const char *kinds[] = {
+                "Int", "Byte", "String", "Var", "BinOp", "Condition", "IfElse", "While",
+                "Call", "Ret", "Assign", "VarDecl", "Param", "Func", "Block"
+            };
+            this->out << "{\"kind\": ";
+            this->string(kinds[(int)node->kind]);
+            this->field("line", node->line);
+            if ( node->kind != NodeKind::IFELSE && node->kind != NodeKind::WHILE
+                    && node->kind != NodeKind::BLOCK )
+                this->field("type", typeName(node->type));
+            switch ( node->kind ) {
+                case NodeKind::INT :
+                    this->field("value", static_cast<Int *>(node)->val);
+                    break;
+                case NodeKind::BYTE :
+                    this->field("value", static_cast<Byte *>(node)->b);
+                    break;
+                case NodeKind::STRING :
+                    this->field("value", static_cast<String *>(node)->s);
+                    break;
+                case NodeKind::VAR : {
+                    auto v = static_cast<Var *>(node);
+                    this->field("name", symbolName(v->id));
+                    this->field("slot", slotOf(v->entry));
+                    this->child("index", v->index);
+                    break;
+                }
+                case NodeKind::BINOP : {
+                    auto b = static_cast<BinOp *>(node);
+                    this->field("op", std::string(1, b->op));
+                    this->child("left", b->left);
+                    this->child("right", b->right);
+                    break;
+                }
+                case NodeKind::CONDITION : {
+                    auto c = static_cast<Condition *>(node);
+                    this->field("op", condNames[(int)c->op]);
+                    this->child("left", c->left);
+                    this->child("right", c->right);
+                    break;
+                }
+                case NodeKind::IFELSE : {
+                    auto i = static_cast<IfElse *>(node);
+                    this->child("cond", i->cond);
+                    this->child("then", i->ifBody);
+                    this->child("else", i->elseBody);
+                    break;
+                }
+                case NodeKind::WHILE : {
+                    auto w = static_cast<While *>(node);
+                    this->child("cond", w->cond);
+                    this->child("body", w->body);
+                    break;
+                }
+                case NodeKind::CALL : {
+                    auto c = static_cast<Call *>(node);
+                    this->field("name", symbolName(c->id));
+                    this->field("slot", slotOf(c->entry));
+                    this->children("args", c->params);
+                    this->children("hidden", c->hidden);
+                    break;
+                }
+                case NodeKind::RET :
+                    this->child("expr", static_cast<Ret *>(node)->expr);
+                    break;
+                case NodeKind::ASSIGN : {
+                    auto a = static_cast<Assign *>(node);
+                    this->child("left", a->left);
+                    this->child("right", a->right);
+                    break;
+                }
+                case NodeKind::VARDECL : {
+                    auto v = static_cast<VarDecl *>(node);
+                    this->field("name", symbolName(v->id));
+                    this->field("slot", slotOf(v->entry));
+                    break;
+                }
+                case NodeKind::PARAM : {
+                    auto p = static_cast<Param *>(node);
+                    this->field("name", symbolName(p->id));
+                    this->field("mode", modeName(p->mode));
+                    this->field("slot", slotOf(p->entry));
+                    break;
+                }
+                case NodeKind::FUNC : {
+                    auto f = static_cast<Func *>(node);
+                    this->field("name", symbolName(f->id));
+                    this->field("slot", slotOf(f->entry));
+                    this->children("params", f->params);
+                    this->children("hidden", f->hidden);
+                    this->children("decls", f->decls);
+                    this->child("body", f->body);
+                    break;
+                }
+                case NodeKind::BLOCK :
+                    this->children("stmts", static_cast<Block *>(node)->stmts);
+                    break;
+            }
+            this->out << "}";
+        }
+};
+
+void dump(astPtr root, bool json) {
+    if ( json ) {
+        JsonDumper(std::cout).dump(root);
+        std::cout << std::endl;
+    } else {
+        TextDumper(std::cout).dump(root);
+    }
+}
+
+} // end namespace ast
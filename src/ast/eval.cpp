@@ -0,0 +1,593 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : eval.cpp                                                     *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Compile-time evaluation of calls with constant arguments     *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <ast/ast.hpp>
+#include <general/arena.hpp>
+#include <options/options.hpp>
+
+/*******************************************************************************
+ * Calls that return an int or a byte and whose arguments are constants are
+ * run here, on the checked ast, and replaced by an Int / Byte node before
+ * codegen ( e.g. `n = fact(10);` becomes `n = 3628800;` ).
+ *   - The callee may loop, recurse, use local arrays and call other
+ *   > functions ( nested ones get their hidden arguments as usual ).
+ *   - Evaluation gives up and the call is left for run time when :
+ *     > it reads input or writes output ( any io function of the library )
+ *     > it writes through a reference to a string literal or reads a
+ *     > variable that was never assigned
+ *     > it does something the generated code leaves undefined ( int
+ *     > overflow without --wrapv, division by zero, index out of bounds,
+ *     > falling off the end of a function that returns a value )
+ *     > it needs more than --eval-steps steps or --eval-depth nested calls
+ *     > it calls an imported function ( its body is in another module )
+ *   - Arguments are evaluated with no frame at all, so a call that reads a
+ *   > variable of its caller is never folded. That also rules out writes
+ *   > to anything the program can see afterwards.
+ *   - Values follow the generated code : ints are 32 bits, bytes are
+ *   > unsigned except for / and % ( sdiv / srem on i8 ), conditions are
+ *   > i32 values tested with `== 1` ( check codegenCond ).
+ * Nothing is folded with --coverage or --instrument-functions, since they
+ * measure what runs at run time.
+ *******************************************************************************/
+
+namespace ast {
+
+/*******************************************************************************
+ * Storage of one variable ( one cell, or one per array element ).
+ * String literals get read-only storage.
+ *******************************************************************************/
+struct Cells {
+    std::vector<long long> v;
+    bool                   readOnly;
+};
+
+/*******************************************************************************
+ * What a slot of a frame is bound to : own storage for variables and value
+ * parameters, somebody else's for reference and hidden parameters.
+ *******************************************************************************/
+struct Ref {
+    Cells     *cells = nullptr;
+    long long  off   = 0;
+};
+
+static const long long UNDEF = LLONG_MIN;
+
+class Evaluator {
+    private :
+        std::vector<Func *>   funcs;
+        std::vector<int>      frameSizes;
+        std::deque<Cells>     heap;
+        std::vector<Ref>     *frame = nullptr;
+        unsigned long long    steps = 0;
+        unsigned long long    depth = 0;
+        bool                  failed = false;
+
+        enum class Flow {
+            NEXT,
+            RETURN
+        };
+
+        long long fail() {
+            this->failed = true;
+            return 0;
+        }
+        bool spend(unsigned long long n) {
+            if ( this->steps < n ) {
+                this->failed = true;
+                return false;
+            }
+            this->steps -= n;
+            return true;
+        }
+        Ref cells(long long n, long long init, bool readOnly);
+        int frameSize(Func *f);
+
+        long long load(Ref r, long long i);
+        void store(Ref r, long long i, long long value);
+        Ref address(Var *v);
+        Ref reference(astPtr arg);
+
+        long long arith(BinOp *b, long long l, long long r);
+        long long expr(astPtr e);
+        long long cond(astPtr c);
+        Flow stmt(astPtr s, long long &ret);
+        long long call(Call *c);
+        long long library(const std::string &name, std::vector<Ref> &args);
+
+        bool evaluate(Call *c, long long &value);
+    public :
+        void collect(astPtr node);
+        void fold(astPtr &node);
+};
+
+/*******************************************************************************
+ ********************************** Storage ************************************
+ *******************************************************************************/
+
+Ref Evaluator::cells(long long n, long long init, bool readOnly) {
+    Ref r;
+    if ( !this->spend(n) )
+        return r;
+    this->heap.push_back(Cells{std::vector<long long>(n, init), readOnly});
+    r.cells = &this->heap.back();
+    return r;
+}
+
+/*******************************************************************************
+ * Parameters, hidden parameters and local variables share the slots of
+ * a function ( check Table::insertEntry ).
+ *******************************************************************************/
+int Evaluator::frameSize(Func *f) {
+    int slot = f->entry->getOffset();
+    if ( this->frameSizes[slot] >= 0 )
+        return this->frameSizes[slot];
+    int size = 0;
+    for ( auto p : f->params )
+        size = std::max(size, static_cast<Param *>(p)->entry->getOffset() + 1);
+    for ( auto h : f->hidden )
+        size = std::max(size, static_cast<Param *>(h)->entry->getOffset() + 1);
+    for ( auto d : f->decls ) {
+        auto v = nodeCast<VarDecl>(d);
+        if ( v != nullptr )
+            size = std::max(size, v->entry->getOffset() + 1);
+    }
+    this->frameSizes[slot] = size;
+    return size;
+}
+
+long long Evaluator::load(Ref r, long long i) {
+    if ( r.cells == nullptr )
+        return this->fail();
+    i += r.off;
+    if ( i < 0 || i >= (long long)r.cells->v.size() || r.cells->v[i] == UNDEF )
+        return this->fail();
+    return r.cells->v[i];
+}
+
+void Evaluator::store(Ref r, long long i, long long value) {
+    if ( r.cells == nullptr || r.cells->readOnly ) {
+        this->fail();
+        return;
+    }
+    i += r.off;
+    if ( i < 0 || i >= (long long)r.cells->v.size() ) {
+        this->fail();
+        return;
+    }
+    r.cells->v[i] = value;
+}
+
+/*******************************************************************************
+ * Address of a variable or of an array element ( like the GEPs of codegen ).
+ *******************************************************************************/
+Ref Evaluator::address(Var *v) {
+    Ref r;
+    int slot = v->entry->getOffset();
+    if ( this->frame == nullptr || slot >= (int)this->frame->size() ) {
+        this->fail();
+        return r;
+    }
+    r = (*this->frame)[slot];
+    if ( r.cells == nullptr ) {
+        this->fail();
+        return r;
+    }
+    if ( v->index != nullptr ) {
+        long long idx = this->expr(v->index);
+        if ( this->failed )
+            return r;
+        r.off += idx;
+        if ( r.off < 0 || r.off >= (long long)r.cells->v.size() )
+            this->fail();
+    }
+    return r;
+}
+
+/*******************************************************************************
+ * Arguments of reference parameters are variables or string literals
+ * ( anything else is reported by Call::codegen ).
+ *******************************************************************************/
+Ref Evaluator::reference(astPtr arg) {
+    if ( auto var = nodeCast<Var>(arg) )
+        return this->address(var);
+    if ( auto str = nodeCast<String>(arg) ) {
+        std::string s(str->s);
+        Ref r = this->cells(s.size() + 1, 0, true);
+        if ( r.cells != nullptr )
+            for ( std::size_t i = 0; i < s.size(); i++ )
+                r.cells->v[i] = (unsigned char)s[i];
+        return r;
+    }
+    this->fail();
+    return Ref();
+}
+
+/*******************************************************************************
+ ********************************* Expressions *********************************
+ *******************************************************************************/
+
+long long Evaluator::arith(BinOp *b, long long l, long long r) {
+    if ( b->type->t == sem::genType::BYTE ) {
+        signed char sl = (signed char)l;
+        signed char sr = (signed char)r;
+        switch ( b->op ) {
+            case '+' : return ( l + r ) & 0xFF;
+            case '-' : return ( l - r ) & 0xFF;
+            case '*' : return ( l * r ) & 0xFF;
+            case '/' :
+            case '%' :
+                if ( sr == 0 || ( sl == -128 && sr == -1 ) )
+                    return this->fail();
+                return ( b->op == '/' ? sl / sr : sl % sr ) & 0xFF;
+        }
+        return this->fail();
+    }
+    long long res;
+    switch ( b->op ) {
+        case '+' : res = l + r; break;
+        case '-' : res = l - r; break;
+        case '*' : res = l * r; break;
+        case '/' :
+        case '%' :
+            if ( r == 0 || ( l == INT32_MIN && r == -1 ) )
+                return this->fail();
+            return b->op == '/' ? l / r : l % r;
+        default :
+            return this->fail();
+    }
+    if ( res < INT32_MIN || res > INT32_MAX ) {
+        if ( !options.wrapv )
+            return this->fail();
+        res = (int32_t)(uint32_t)res;
+    }
+    return res;
+}
+
+long long Evaluator::expr(astPtr e) {
+    if ( this->failed || !this->spend(1) )
+        return 0;
+    switch ( e->kind ) {
+        case NodeKind::INT :
+            return static_cast<Int *>(e)->val;
+        case NodeKind::BYTE :
+            return static_cast<Byte *>(e)->b;
+        case NodeKind::VAR : {
+            Ref r = this->address(static_cast<Var *>(e));
+            if ( this->failed )
+                return 0;
+            return this->load(r, 0);
+        }
+        case NodeKind::BINOP : {
+            auto b = static_cast<BinOp *>(e);
+            long long l = this->expr(b->left);
+            long long r = this->expr(b->right);
+            if ( this->failed )
+                return 0;
+            return this->arith(b, l, r);
+        }
+        case NodeKind::CALL :
+            return this->call(static_cast<Call *>(e));
+        default :
+            return this->fail();
+    }
+}
+
+/*******************************************************************************
+ * Same values as Condition::codegen : comparisons give 0 / 1, operands
+ * are zero extended to 32 bits, `!` is a logical not.
+ *******************************************************************************/
+long long Evaluator::cond(astPtr c) {
+    if ( this->failed || !this->spend(1) )
+        return 0;
+    if ( c->kind != NodeKind::CONDITION )
+        return (uint32_t)this->expr(c);
+    auto cd = static_cast<Condition *>(c);
+    long long l = 0, r = 0;
+    if ( cd->left != nullptr )
+        l = this->cond(cd->left);
+    if ( cd->right != nullptr )
+        r = this->cond(cd->right);
+    if ( this->failed )
+        return 0;
+    int32_t sl = (int32_t)l, sr = (int32_t)r;
+    switch ( cd->op ) {
+        case Cond::TRU  : return 1;
+        case Cond::FALS : return 0;
+        case Cond::EQ   : return sl == sr;
+        case Cond::NEQ  : return sl != sr;
+        case Cond::LT   : return sl < sr;
+        case Cond::LE   : return sl <= sr;
+        case Cond::GT   : return sl > sr;
+        case Cond::GE   : return sl >= sr;
+        case Cond::AND  : return (uint32_t)( l & r );
+        case Cond::OR   : return (uint32_t)( l | r );
+        case Cond::NOT  : return r == 0;
+    }
+    return this->fail();
+}
+
+/*******************************************************************************
+ ********************************* Statements **********************************
+ *******************************************************************************/
+
+Evaluator::Flow Evaluator::stmt(astPtr s, long long &ret) {
+    if ( s == nullptr || this->failed || !this->spend(1) )
+        return Flow::NEXT;
+    switch ( s->kind ) {
+        case NodeKind::ASSIGN : {
+            auto a = static_cast<Assign *>(s);
+            long long value = this->expr(a->right);
+            Ref r = this->address(static_cast<Var *>(a->left));
+            if ( !this->failed )
+                this->store(r, 0, value);
+            return Flow::NEXT;
+        }
+        case NodeKind::IFELSE : {
+            auto i = static_cast<IfElse *>(s);
+            long long c = this->cond(i->cond);
+            if ( this->failed )
+                return Flow::NEXT;
+            return this->stmt(c == 1 ? i->ifBody : i->elseBody, ret);
+        }
+        case NodeKind::WHILE : {
+            auto w = static_cast<While *>(s);
+            while ( this->cond(w->cond) == 1 && !this->failed )
+                if ( this->stmt(w->body, ret) == Flow::RETURN )
+                    return Flow::RETURN;
+            return Flow::NEXT;
+        }
+        case NodeKind::CALL :
+            this->call(static_cast<Call *>(s));
+            return Flow::NEXT;
+        case NodeKind::RET :
+            ret = this->expr(static_cast<Ret *>(s)->expr);
+            return Flow::RETURN;
+        case NodeKind::BLOCK :
+            for ( auto st : static_cast<Block *>(s)->stmts )
+                if ( this->stmt(st, ret) == Flow::RETURN )
+                    return Flow::RETURN;
+            return Flow::NEXT;
+        default :
+            this->expr(s);
+            return Flow::NEXT;
+    }
+}
+
+/*******************************************************************************
+ *********************************** Calls *************************************
+ *******************************************************************************/
+
+long long Evaluator::call(Call *c) {
+    if ( this->failed )
+        return 0;
+    auto entry = c->entry;
+    auto &pars = entry->getParams();
+    /**
+     * Storage of the callee starts with its value parameters,
+     * everything after `mark` is dropped when it returns
+     */
+    std::size_t mark = this->heap.size();
+    std::vector<Ref> args;
+    for ( std::size_t i = 0; i < c->params.size(); i++ ) {
+        if ( pars[i]->getMode() == sem::PassMode::REFERENCE ) {
+            args.push_back(this->reference(c->params[i]));
+        } else {
+            long long v = this->expr(c->params[i]);
+            args.push_back(this->cells(1, v, false));
+        }
+        if ( this->failed )
+            return 0;
+    }
+    int slot = entry->getOffset();
+    Func *f = slot < (int)this->funcs.size() ? this->funcs[slot] : nullptr;
+    if ( f == nullptr ) {
+        long long ret = this->library(symbolName(entry->id), args);
+        this->heap.resize(mark);
+        return ret;
+    }
+    if ( c->hidden.size() != entry->getHidden().size() )
+        return this->fail();
+    for ( auto h : c->hidden ) {
+        args.push_back(this->address(static_cast<Var *>(h)));
+        if ( this->failed )
+            return 0;
+    }
+    if ( this->depth >= options.evalDepth )
+        return this->fail();
+    std::vector<Ref> callee(this->frameSize(f));
+    for ( std::size_t i = 0; i < f->params.size(); i++ )
+        callee[static_cast<Param *>(f->params[i])->entry->getOffset()] = args[i];
+    for ( std::size_t i = 0; i < f->hidden.size(); i++ )
+        callee[static_cast<Param *>(f->hidden[i])->entry->getOffset()] = args[f->params.size() + i];
+    for ( auto d : f->decls ) {
+        auto v = nodeCast<VarDecl>(d);
+        if ( v == nullptr )
+            continue;
+        long long n = v->type->t == sem::genType::ARRAY ? v->type->getSize() : 1;
+        callee[v->entry->getOffset()] = this->cells(n, UNDEF, false);
+        if ( this->failed )
+            return 0;
+    }
+    auto *caller = this->frame;
+    this->frame = &callee;
+    this->depth++;
+    long long ret = 0;
+    Flow flow = this->stmt(f->body, ret);
+    this->depth--;
+    this->frame = caller;
+    this->heap.resize(mark);
+    if ( flow != Flow::RETURN && f->type->t != sem::genType::VOID )
+        return this->fail();
+    return ret;
+}
+
+/*******************************************************************************
+ * The functions of lib.c that do no io.
+ *******************************************************************************/
+long long Evaluator::library(const std::string &name, std::vector<Ref> &args) {
+    /**
+     * Functions are only recognized by name, and interfaces of imported
+     * modules are not checked against the library, so the arguments are
+     * counted before they are used
+     */
+    std::size_t count = ( name == "strcmp" || name == "strcpy" || name == "strcat" ) ? 2 : 1;
+    if ( args.size() != count )
+        return this->fail();
+    if ( name == "extend" )
+        return this->load(args[0], 0);
+    if ( name == "shrink" )
+        return this->load(args[0], 0) & 0xFF;
+    if ( name == "strlen" ) {
+        long long n = 0;
+        while ( this->load(args[0], n) != 0 && !this->failed && this->spend(1) )
+            n++;
+        return n;
+    }
+    if ( name == "strcmp" ) {
+        for ( long long i = 0; !this->failed && this->spend(1); i++ ) {
+            long long a = this->load(args[0], i);
+            long long b = this->load(args[1], i);
+            if ( a != b )
+                return a < b ? -1 : 1;
+            if ( a == 0 )
+                return 0;
+        }
+        return 0;
+    }
+    if ( name == "strcpy" || name == "strcat" ) {
+        long long i = 0;
+        if ( name == "strcat" )
+            while ( this->load(args[0], i) != 0 && !this->failed && this->spend(1) )
+                i++;
+        for ( long long j = 0; !this->failed && this->spend(1); j++ ) {
+            long long ch = this->load(args[1], j);
+            this->store(args[0], i + j, ch);
+            if ( ch == 0 )
+                break;
+        }
+        return 0;
+    }
+    return this->fail();
+}
+
+/*******************************************************************************
+ ********************************** Folding ************************************
+ *******************************************************************************/
+
+/*******************************************************************************
+ * Every function by its slot ( library and imported functions have none ).
+ *******************************************************************************/
+void Evaluator::collect(astPtr node) {
+    auto f = nodeCast<Func>(node);
+    if ( f == nullptr )
+        return;
+    std::size_t slot = f->entry->getOffset();
+    if ( slot >= this->funcs.size() ) {
+        this->funcs.resize(slot + 1, nullptr);
+        this->frameSizes.resize(slot + 1, -1);
+    }
+    this->funcs[slot] = f;
+    for ( auto d : f->decls )
+        this->collect(d);
+}
+
+bool Evaluator::evaluate(Call *c, long long &value) {
+    this->steps  = options.evalSteps;
+    this->depth  = 0;
+    this->failed = false;
+    this->frame  = nullptr;
+    value = this->call(c);
+    this->heap.clear();
+    return !this->failed;
+}
+
+/*******************************************************************************
+ * Arguments are folded first, so `f(g(1))` folds g and then f.
+ *******************************************************************************/
+void Evaluator::fold(astPtr &node) {
+    if ( node == nullptr )
+        return;
+    switch ( node->kind ) {
+        case NodeKind::VAR :
+            this->fold(static_cast<Var *>(node)->index);
+            return;
+        case NodeKind::BINOP :
+            this->fold(static_cast<BinOp *>(node)->left);
+            this->fold(static_cast<BinOp *>(node)->right);
+            return;
+        case NodeKind::CONDITION :
+            this->fold(static_cast<Condition *>(node)->left);
+            this->fold(static_cast<Condition *>(node)->right);
+            return;
+        case NodeKind::IFELSE :
+            this->fold(static_cast<IfElse *>(node)->cond);
+            this->fold(static_cast<IfElse *>(node)->ifBody);
+            this->fold(static_cast<IfElse *>(node)->elseBody);
+            return;
+        case NodeKind::WHILE :
+            this->fold(static_cast<While *>(node)->cond);
+            this->fold(static_cast<While *>(node)->body);
+            return;
+        case NodeKind::RET :
+            this->fold(static_cast<Ret *>(node)->expr);
+            return;
+        case NodeKind::ASSIGN :
+            this->fold(static_cast<Assign *>(node)->left);
+            this->fold(static_cast<Assign *>(node)->right);
+            return;
+        case NodeKind::FUNC :
+            for ( auto &d : static_cast<Func *>(node)->decls )
+                this->fold(d);
+            this->fold(static_cast<Func *>(node)->body);
+            return;
+        case NodeKind::BLOCK :
+            for ( auto &s : static_cast<Block *>(node)->stmts )
+                this->fold(s);
+            return;
+        case NodeKind::CALL :
+            break;
+        default :
+            return;
+    }
+    auto c = static_cast<Call *>(node);
+    for ( auto &p : c->params )
+        this->fold(p);
+    if ( c->type->t != sem::genType::INT && c->type->t != sem::genType::BYTE )
+        return;
+    long long value;
+    if ( !this->evaluate(c, value) )
+        return;
+    astPtr constant;
+    if ( c->type->t == sem::genType::INT )
+        constant = newNode<Int>((int)value);
+    else
+        constant = newNode<Byte>((unsigned char)value);
+    constant->line = c->line;
+    node = constant;
+}
+
+void evaluate(astPtr root) {
+    if ( options.evalSteps == 0 || options.coverage || options.instrumentFunctions )
+        return;
+    Evaluator evaluator;
+    evaluator.collect(root);
+    evaluator.fold(root);
+}
+
+} // end namespace ast
@@ -14,13 +14,23 @@
  ******************************** LLVM includes ********************************
  *******************************************************************************/
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Triple.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
 
 /*******************************************************************************
  ****************************** Project Includes *******************************
@@ -28,8 +38,11 @@
 
 #include <ast/ast.hpp>
 #include <codegen/codegen.hpp>
+#include <codegen/debug.hpp>
 #include <general/general.hpp>
+#include <options/options.hpp>
 #include <symbol/entry.hpp>
+#include <symbol/interface.hpp>
 #include <symbol/types.hpp>
 
 /*******************************************************************************
@@ -42,14 +55,53 @@
  **************************** Global File Variables ****************************
  *******************************************************************************/
 
-extern char *filename;
-
 static llvm::LLVMContext TheContext;
 static llvm::IRBuilder<> Builder(TheContext);
 static std::unique_ptr<llvm::Module> TheModule;
 
 static GenStack genBlocks;
 static GenScope scopes;
+static GenDebug debugInfo;
+
+/*******************************************************************************
+ * Profiling hooks of the runtime ( null unless --instrument-functions ).
+ * Functions are named after their parents, so `funcNames` follows nesting.
+ *******************************************************************************/
+static llvm::Function *enterHook = nullptr;
+static llvm::Function *exitHook = nullptr;
+static std::vector<std::string> funcNames;
+
+/*******************************************************************************
+ * Coverage counters ( only with --coverage ).
+ * The number of counters is known after codegen, so increments address a
+ * placeholder array that is replaced by the real one in `codegenCoverage`.
+ *******************************************************************************/
+static llvm::GlobalVariable *counters = nullptr;
+static std::vector<int> counterLines;
+
+/*******************************************************************************
+ * Heap frames of big arrays in recursive functions ( check lib.c ).
+ * Declared the first time they are needed.
+ *******************************************************************************/
+static llvm::Function *heapAlloc = nullptr;
+static llvm::Function *heapFree = nullptr;
+
+/*******************************************************************************
+ * Cpu and features recorded in every generated function ( check codegenTarget ).
+ *******************************************************************************/
+static std::string targetCPU;
+static std::string targetFeatures;
+
+/*******************************************************************************
+ * Type-based alias analysis tags ( check codegenTBAA ).
+ *******************************************************************************/
+static llvm::MDNode *tbaaInt = nullptr;
+static llvm::MDNode *tbaaByte = nullptr;
+static llvm::MDNode *tbaaPointer = nullptr;
+static llvm::MDNode *tbaaCounter = nullptr;
+
+#define STACK_ARRAY_ALIGN 32
+#define BIG_ARRAY_ALIGN 64
 
 /*******************************************************************************
  * Alan types for easier use.
@@ -57,6 +109,7 @@ static GenScope scopes;
  *******************************************************************************/
 static llvm::Type *i32 = llvm::Type::getInt32Ty(TheContext);
 static llvm::Type *i8 = llvm::Type::getInt8Ty(TheContext);
+static llvm::Type *i64 = llvm::Type::getInt64Ty(TheContext);
 static llvm::Type *proc = llvm::Type::getVoidTy(TheContext);
 
 static inline llvm::Constant *c32(int n) {
@@ -67,11 +120,31 @@ static inline llvm::Constant *c8(unsigned char b) {
     return llvm::ConstantInt::get(i8, b);
 }
 
+static inline llvm::Constant *c64(int64_t n) {
+    return llvm::ConstantInt::get(i64, n);
+}
+
 /*******************************************************************************
  **************************** Function Declarations ****************************
  *******************************************************************************/
 
 static void codegenLibs();
+static void codegenImports();
+static void codegenHooks();
+static void codegenExitHook();
+static void codegenEpilogue();
+static llvm::Value *codegenArray(sem::TypePtr type, const std::string &name);
+static void codegenCounter(int line);
+static void codegenCoverage();
+static llvm::Value *codegenCond(ast::astPtr cond);
+static llvm::Value *codegenIndex(ast::astPtr index);
+static void codegenTBAA();
+static void codegenTarget();
+static void setTargetAttributes(llvm::Function *func);
+static llvm::MDNode *tbaaTag(sem::TypePtr type);
+static llvm::Value *tbaa(llvm::Instruction *inst, llvm::MDNode *tag);
+static llvm::Value *loadAddr(int slot);
+static llvm::Type *translateBaseType(sem::TypePtr type);
 
 namespace ast {
 
@@ -81,22 +154,47 @@ namespace ast {
 
 void codegen(astPtr root) {
     TheModule = llvm::make_unique<llvm::Module>(filename, TheContext);
-    scopes.openScope();
+    codegenTarget();
+    if (options.debugInfo || options.lineTables)
+        debugInfo.init(*TheModule, filename,
+                       TheModule->getDataLayout().getPointerSizeInBits(),
+                       !options.debugInfo);
     codegenLibs();
+    codegenImports();
+    codegenTBAA();
+    if (options.instrumentFunctions)
+        codegenHooks();
+    if (options.coverage)
+        counters = new llvm::GlobalVariable(
+            *TheModule, llvm::ArrayType::get(i64, 0), false,
+            llvm::GlobalValue::InternalLinkage, nullptr, "__alan_counters");
+    /**
+     * A module only exports its top-level function,
+     * the entry point belongs to the program that imports it
+     */
+    if (options.module) {
+        root->codegen();
+        debugInfo.finalize();
+        TheModule->print(llvm::outs(), nullptr);
+        return;
+    }
     auto *mainType =
         llvm::FunctionType::get(i32, std::vector<llvm::Type *>{}, false);
     auto *mainFunc = llvm::Function::Create(
         mainType, llvm::Function::ExternalLinkage, "main", TheModule.get());
+    setTargetAttributes(mainFunc);
     llvm::BasicBlock *mainBB =
         llvm::BasicBlock::Create(TheContext, "entry", mainFunc);
     root->codegen();
-    auto alanMain = std::dynamic_pointer_cast<ast::Func>(root);
-    auto *alanMainFunc = scopes.getFunc(alanMain->id);
+    auto alanMain = nodeCast<ast::Func>(root);
+    auto *alanMainFunc = scopes.getFunc(alanMain->entry->getOffset());
     std::vector<llvm::Value *> alanArgs;
     Builder.SetInsertPoint(mainBB);
+    if (counters != nullptr)
+        codegenCoverage();
     Builder.CreateCall(alanMainFunc, alanArgs);
     Builder.CreateRet(llvm::ConstantInt::get(i32, 0));
-    scopes.closeScope();
+    debugInfo.finalize();
     TheModule->print(llvm::outs(), nullptr);
 }
 
@@ -104,6 +202,42 @@ void codegen(astPtr root) {
  ***************************** AST Codegen Methods *****************************
  *******************************************************************************/
 
+llvm::Value *Node::codegen() {
+    switch (this->kind) {
+    case NodeKind::INT:
+        return static_cast<Int *>(this)->codegen();
+    case NodeKind::BYTE:
+        return static_cast<Byte *>(this)->codegen();
+    case NodeKind::STRING:
+        return static_cast<String *>(this)->codegen();
+    case NodeKind::VAR:
+        return static_cast<Var *>(this)->codegen();
+    case NodeKind::BINOP:
+        return static_cast<BinOp *>(this)->codegen();
+    case NodeKind::CONDITION:
+        return static_cast<Condition *>(this)->codegen();
+    case NodeKind::IFELSE:
+        return static_cast<IfElse *>(this)->codegen();
+    case NodeKind::WHILE:
+        return static_cast<While *>(this)->codegen();
+    case NodeKind::CALL:
+        return static_cast<Call *>(this)->codegen();
+    case NodeKind::RET:
+        return static_cast<Ret *>(this)->codegen();
+    case NodeKind::ASSIGN:
+        return static_cast<Assign *>(this)->codegen();
+    case NodeKind::VARDECL:
+        return static_cast<VarDecl *>(this)->codegen();
+    case NodeKind::PARAM:
+        return static_cast<Param *>(this)->codegen();
+    case NodeKind::FUNC:
+        return static_cast<Func *>(this)->codegen();
+    case NodeKind::BLOCK:
+        return static_cast<Block *>(this)->codegen();
+    }
+    return nullptr;
+}
+
 llvm::Value *Int::codegen() { return c32(this->val); }
 
 llvm::Value *Byte::codegen() { return c8(this->b); }
@@ -113,44 +247,54 @@ llvm::Value *String::codegen() {
 }
 
 llvm::Value *Var::codegen() {
+    int slot = this->entry->getOffset();
     /* Normal Variable First */
+    auto *tag = tbaaTag(this->type);
     if (this->index == nullptr) {
-        if (genBlocks.front()->isRef(this->id)) {
-            auto *addr =
-                Builder.CreateLoad(genBlocks.front()->getAddr(this->id));
-            return Builder.CreateLoad(addr);
+        if (genBlocks.front()->isRef(slot)) {
+            auto *addr = loadAddr(slot);
+            return tbaa(Builder.CreateLoad(addr), tag);
         } else {
-            return Builder.CreateLoad(genBlocks.front()->getVal(this->id));
+            return tbaa(Builder.CreateLoad(genBlocks.front()->getVal(slot)),
+                        tag);
         }
     }
     /* Array Variable */
     else {
-        auto *idx = this->index->codegen();
-        if (genBlocks.front()->isRef(this->id)) {
-            auto *ptr =
-                Builder.CreateLoad(genBlocks.front()->getAddr(this->id));
-            auto *addr = Builder.CreateGEP(ptr, idx);
-            return Builder.CreateLoad(addr);
+        auto *idx = codegenIndex(this->index);
+        if (genBlocks.front()->isRef(slot)) {
+            auto *ptr = loadAddr(slot);
+            auto *addr = Builder.CreateInBoundsGEP(ptr, idx);
+            return tbaa(Builder.CreateLoad(addr), tag);
         } else {
-            return Builder.CreateLoad(
-                Builder.CreateGEP(genBlocks.front()->getVal(this->id),
-                                  std::vector<llvm::Value *>{c32(0), idx}));
+            return tbaa(Builder.CreateLoad(Builder.CreateInBoundsGEP(
+                            genBlocks.front()->getVal(slot),
+                            std::vector<llvm::Value *>{c64(0), idx})),
+                        tag);
         }
     }
     /* Fail */
     return nullptr;
 }
 
+/*******************************************************************************
+ * Overflow policy :
+ *   - int arithmetic that overflows is undefined, so +, - and * are `nsw`
+ *   > ( that lets SCEV and the vectorizer reason about index expressions ).
+ *   > `--wrapv` makes it wrap ( two's complement ) instead.
+ *   - byte arithmetic always wraps modulo 256.
+ *******************************************************************************/
 llvm::Value *BinOp::codegen() {
     auto *lhs = this->left->codegen();
     auto *rhs = this->right->codegen();
+    bool nsw = lhs->getType()->isIntegerTy(32) && !options.wrapv;
     switch (this->op) {
     case '+':
-        return Builder.CreateAdd(lhs, rhs, "addtmp");
+        return Builder.CreateAdd(lhs, rhs, "addtmp", false, nsw);
     case '-':
-        return Builder.CreateSub(lhs, rhs, "subtmp");
+        return Builder.CreateSub(lhs, rhs, "subtmp", false, nsw);
     case '*':
-        return Builder.CreateMul(lhs, rhs, "multmp");
+        return Builder.CreateMul(lhs, rhs, "multmp", false, nsw);
     case '/':
         return Builder.CreateSDiv(lhs, rhs, "divtmp");
     case '%':
@@ -191,7 +335,7 @@ llvm::Value *Condition::codegen() {
     case ast::Cond::OR:
         return Builder.CreateOr(lhs, rhs, "ortmp");
     case ast::Cond::NOT:
-        return Builder.CreateNot(rhs, "nottmp");
+        return Builder.CreateICmpEQ(rhs, c32(0), "nottmp");
     }
     return nullptr;
 }
@@ -200,11 +344,7 @@ llvm::Value *IfElse::codegen() {
     llvm::Function *TheFunction = genBlocks.front()->getFunc();
 
     /* condition */
-    auto *CondV = this->cond->codegen();
-    if (!CondV->getType()->isIntegerTy(32)) {
-        CondV = Builder.CreateZExt(CondV, i32);
-    }
-    CondV = Builder.CreateICmpEQ(CondV, c32(1));
+    auto *CondV = codegenCond(this->cond);
 
     llvm::BasicBlock *ThenBB =
         llvm::BasicBlock::Create(TheContext, "then", TheFunction);
@@ -215,6 +355,7 @@ llvm::Value *IfElse::codegen() {
     /* if block */
     Builder.SetInsertPoint(ThenBB);
     genBlocks.front()->setCurrentBlock(ThenBB);
+    codegenCounter(this->ifBody->line);
     this->ifBody->codegen();
     if (!genBlocks.front()->hasReturn())
         Builder.CreateBr(MergeBB);
@@ -223,8 +364,10 @@ llvm::Value *IfElse::codegen() {
     TheFunction->getBasicBlockList().push_back(ElseBB);
     Builder.SetInsertPoint(ElseBB);
     genBlocks.front()->setCurrentBlock(ElseBB);
-    if (this->elseBody != nullptr)
+    if (this->elseBody != nullptr) {
+        codegenCounter(this->elseBody->line);
         this->elseBody->codegen();
+    }
     if (!genBlocks.front()->hasReturn())
         Builder.CreateBr(MergeBB);
 
@@ -236,32 +379,38 @@ llvm::Value *IfElse::codegen() {
     return nullptr;
 }
 
+/*******************************************************************************
+ * Loops are lowered to a single header block that evaluates the condition :
+ *   - entry  -> cond
+ *   - cond   -> loop | after
+ *   - loop   -> cond
+ * so the condition is emitted exactly once and the loop has one latch, which
+ * is the shape LLVM loop passes (loop-rotate, licm, indvars) expect.
+ *******************************************************************************/
 llvm::Value *While::codegen() {
     llvm::Function *TheFunction = genBlocks.front()->getFunc();
 
-    /* condition */
-    auto *CondV = this->cond->codegen();
-    if (!CondV->getType()->isIntegerTy(32)) {
-        CondV = Builder.CreateZExt(CondV, i32);
-    }
-    CondV = Builder.CreateICmpEQ(CondV, c32(1));
-
-    llvm::BasicBlock *LoopBB =
-        llvm::BasicBlock::Create(TheContext, "loop", TheFunction);
+    llvm::BasicBlock *CondBB =
+        llvm::BasicBlock::Create(TheContext, "cond", TheFunction);
+    llvm::BasicBlock *LoopBB = llvm::BasicBlock::Create(TheContext, "loop");
     llvm::BasicBlock *AfterBB = llvm::BasicBlock::Create(TheContext, "after");
 
+    Builder.CreateBr(CondBB);
+
+    /* condition */
+    Builder.SetInsertPoint(CondBB);
+    genBlocks.front()->setCurrentBlock(CondBB);
+    auto *CondV = codegenCond(this->cond);
     Builder.CreateCondBr(CondV, LoopBB, AfterBB);
 
     /* loop body */
+    TheFunction->getBasicBlockList().push_back(LoopBB);
     Builder.SetInsertPoint(LoopBB);
     genBlocks.front()->setCurrentBlock(LoopBB);
+    codegenCounter(this->body->line);
     this->body->codegen();
-    auto *nextCond = this->cond->codegen();
-    if (!nextCond->getType()->isIntegerTy(32)) {
-        nextCond = Builder.CreateZExt(nextCond, i32);
-    }
-    nextCond = Builder.CreateICmpEQ(nextCond, c32(1));
-    Builder.CreateCondBr(nextCond, LoopBB, AfterBB);
+    if (!genBlocks.front()->hasReturn())
+        Builder.CreateBr(CondBB);
 
     /* after body */
     TheFunction->getBasicBlockList().push_back(AfterBB);
@@ -272,53 +421,58 @@ llvm::Value *While::codegen() {
 }
 
 llvm::Value *Call::codegen() {
-    llvm::Function *TheFunction = scopes.getFunc(this->id);
-    for (auto &param : this->hidden) {
-        this->params.push_back(param);
-    }
+    llvm::Function *TheFunction = scopes.getFunc(this->entry->getOffset());
     std::vector<llvm::Value *> callArgs;
 
+    /**
+     * Normal parameters are followed by the hidden ones.
+     * They are not merged into `params`, so that generating
+     * the same call twice produces the same arguments.
+     */
+    auto argAt = [this](int index) -> astPtr & {
+        if (index < this->params.size())
+            return this->params[index];
+        return this->hidden[index - this->params.size()];
+    };
+
     int index = 0;
     for (auto &Arg : TheFunction->args()) {
         /* If argument by reference */
         if (Arg.getType()->isPointerTy()) {
-            auto var = std::dynamic_pointer_cast<ast::Var>(this->params[index]);
+            auto var = nodeCast<ast::Var>(argAt(index));
             /* Found variable */
             if (var) {
+                int slot = var->entry->getOffset();
                 if (var->index == nullptr) {
-                    if (genBlocks.front()->isRef(var->id)) {
-                        auto par = Builder.CreateLoad(
-                            genBlocks.front()->getAddr(var->id));
-                        callArgs.push_back(par);
+                    if (genBlocks.front()->isRef(slot)) {
+                        callArgs.push_back(loadAddr(slot));
                     } else {
                         llvm::Value *par;
-                        if (genBlocks.front()->getVar(var->id)->isArrayTy())
-                            par = Builder.CreateGEP(
-                                genBlocks.front()->getVal(var->id),
-                                std::vector<llvm::Value *>{c32(0), c32(0)});
+                        if (genBlocks.front()->getVar(slot)->isArrayTy())
+                            par = Builder.CreateInBoundsGEP(
+                                genBlocks.front()->getVal(slot),
+                                std::vector<llvm::Value *>{c64(0), c64(0)});
                         else
-                            par = genBlocks.front()->getVal(var->id);
+                            par = genBlocks.front()->getVal(slot);
                         callArgs.push_back(par);
                     }
                 } else {
-                    auto idx = var->index->codegen();
-                    if (genBlocks.front()->isRef(var->id)) {
-                        llvm::Value *par = Builder.CreateLoad(
-                            genBlocks.front()->getAddr(var->id));
-                        par = Builder.CreateGEP(par, idx);
+                    auto idx = codegenIndex(var->index);
+                    if (genBlocks.front()->isRef(slot)) {
+                        llvm::Value *par = loadAddr(slot);
+                        par = Builder.CreateInBoundsGEP(par, idx);
                         callArgs.push_back(par);
                     } else {
-                        llvm::Value *par = genBlocks.front()->getVal(var->id);
-                        par = Builder.CreateGEP(
-                            par, std::vector<llvm::Value *>{c32(0), idx});
+                        llvm::Value *par = genBlocks.front()->getVal(slot);
+                        par = Builder.CreateInBoundsGEP(
+                            par, std::vector<llvm::Value *>{c64(0), idx});
                         callArgs.push_back(par);
                     }
                 }
                 index++;
                 continue;
             }
-            auto strlit =
-                std::dynamic_pointer_cast<ast::String>(this->params[index]);
+            auto strlit = nodeCast<ast::String>(argAt(index));
             /* Found string literal */
             if (strlit) {
                 callArgs.push_back(strlit->codegen());
@@ -328,7 +482,7 @@ llvm::Value *Call::codegen() {
             linecount = this->line;
             error("Expected variable or string literal");
         } else {
-            auto par = this->params[index];
+            auto par = argAt(index);
             callArgs.push_back(par->codegen());
             index++;
         }
@@ -338,51 +492,70 @@ llvm::Value *Call::codegen() {
 
 llvm::Value *Ret::codegen() {
     genBlocks.front()->addRet();
-    return Builder.CreateRet(this->expr->codegen());
+    auto *val = this->expr->codegen();
+    codegenEpilogue();
+    return Builder.CreateRet(val);
 }
 
 llvm::Value *Assign::codegen() {
-    auto lval = std::dynamic_pointer_cast<ast::Var>(left);
+    auto lval = static_cast<ast::Var *>(left);
     auto *rval = this->right->codegen();
+    int slot = lval->entry->getOffset();
+    auto *tag = tbaaTag(lval->type);
     /* Normal Variable */
     if (lval->index == nullptr) {
-        if (genBlocks.front()->isRef(lval->id)) {
-            auto *addr =
-                Builder.CreateLoad(genBlocks.front()->getAddr(lval->id));
-            return Builder.CreateStore(rval, addr);
+        if (genBlocks.front()->isRef(slot)) {
+            auto *addr = loadAddr(slot);
+            return tbaa(Builder.CreateStore(rval, addr), tag);
         } else {
-            return Builder.CreateStore(rval,
-                                       genBlocks.front()->getVal(lval->id));
+            return tbaa(
+                Builder.CreateStore(rval, genBlocks.front()->getVal(slot)),
+                tag);
         }
     }
     /* Array Variable */
     else {
-        auto *idx = lval->index->codegen();
+        auto *idx = codegenIndex(lval->index);
         llvm::Value *val;
-        if (genBlocks.front()->isRef(lval->id)) {
-            val = Builder.CreateLoad(genBlocks.front()->getAddr(lval->id));
-            val = Builder.CreateGEP(val, idx);
+        if (genBlocks.front()->isRef(slot)) {
+            val = loadAddr(slot);
+            val = Builder.CreateInBoundsGEP(val, idx);
         } else {
-            val = Builder.CreateGEP(genBlocks.front()->getVal(lval->id),
-                                    std::vector<llvm::Value *>{c32(0), idx});
+            val = Builder.CreateInBoundsGEP(
+                genBlocks.front()->getVal(slot),
+                std::vector<llvm::Value *>{c64(0), idx});
         }
-        return Builder.CreateStore(rval, val);
+        return tbaa(Builder.CreateStore(rval, val), tag);
     }
     /* Fail */
     return nullptr;
 }
 
 llvm::Value *VarDecl::codegen() {
-    auto *type = translateType(this->type);
-    auto *alloca = Builder.CreateAlloca(type, nullptr, this->id);
-    genBlocks.front()->addVar(this->id, this->type);
-    genBlocks.front()->addVal(this->id, alloca);
+    llvm::Value *storage;
+    if (this->type->t == sem::genType::ARRAY) {
+        storage = codegenArray(this->type, symbolName(this->id));
+    } else {
+        storage = Builder.CreateAlloca(translateType(this->type), nullptr,
+                                       symbolName(this->id));
+    }
+    const std::string &name = symbolName(this->id);
+    if (auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(storage))
+        debugInfo.declareVar(alloca, name, this->line, this->type,
+                             Builder.GetInsertBlock());
+    else if (auto *global = llvm::dyn_cast<llvm::GlobalVariable>(storage))
+        debugInfo.declareGlobal(global, name, this->line, this->type);
+    else
+        debugInfo.declareFrame(Builder, storage, name, this->line, this->type);
+    genBlocks.front()->addVar(this->entry->getOffset(), this->type);
+    genBlocks.front()->addVal(this->entry->getOffset(), storage);
     return nullptr;
 }
 
 llvm::Value *Param::codegen() {
-    genBlocks.front()->addArg(this->id, this->type, this->mode);
-    genBlocks.front()->addVar(this->id, this->type, this->mode);
+    int slot = this->entry->getOffset();
+    genBlocks.front()->addArg(slot, this->type, this->mode);
+    genBlocks.front()->addVar(slot, this->type, this->mode);
     return nullptr;
 }
 
@@ -392,53 +565,83 @@ llvm::Value *Func::codegen() {
     for (auto par : this->params)
         par->codegen();
     for (auto hid : this->hidden) {
-        auto hidpar = std::dynamic_pointer_cast<ast::Param>(hid);
+        auto hidpar = static_cast<ast::Param *>(hid);
         hidpar->codegen();
     }
     llvm::FunctionType *ftype = llvm::FunctionType::get(
         translateType(this->type), genBlocks.front()->getArgs(), false);
+    /**
+     * Only the top-level function is visible outside the module,
+     * so nested functions of different modules never clash
+     */
+    auto linkage = this->main ? llvm::Function::ExternalLinkage
+                              : llvm::Function::InternalLinkage;
     llvm::Function *func = llvm::Function::Create(
-        ftype, llvm::Function::ExternalLinkage, this->id, TheModule.get());
+        ftype, linkage, symbolName(this->id), TheModule.get());
     genBlocks.front()->setFunc(func);
-    scopes.addFunc(this->id, func);
-
-    scopes.openScope();
+    setTargetAttributes(func);
+    genBlocks.front()->setRecursive(this->entry->isRecursive());
+    scopes.addFunc(this->entry->getOffset(), func);
 
+    std::vector<ast::Param *> argParams;
+    std::vector<sem::TypePtr> argTypes;
+    std::vector<sem::PassMode> argModes;
     int index = 0;
     int hindex = 0;
     for (auto &Arg : func->args()) {
-        if (index == this->params.size()) {
-            auto h =
-                std::dynamic_pointer_cast<ast::Param>(this->hidden[hindex++]);
-            Arg.setName(h->id);
-        } else {
-            auto p =
-                std::dynamic_pointer_cast<ast::Param>(this->params[index++]);
-            Arg.setName(p->id);
-        }
+        ast::Param *p;
+        if (index == this->params.size())
+            p = static_cast<ast::Param *>(this->hidden[hindex++]);
+        else
+            p = static_cast<ast::Param *>(this->params[index++]);
+        argParams.push_back(p);
+        argTypes.push_back(p->type);
+        argModes.push_back(p->mode);
+        Arg.setName(symbolName(p->id));
     }
+    debugInfo.openFunc(func, symbolName(this->id), this->line, this->type,
+                       argTypes, argModes);
+    if (funcNames.empty())
+        funcNames.push_back(symbolName(this->id));
+    else
+        funcNames.push_back(funcNames.back() + "." + symbolName(this->id));
 
     llvm::BasicBlock *FuncBB =
         llvm::BasicBlock::Create(TheContext, "entry", func);
     Builder.SetInsertPoint(FuncBB);
     genBlocks.front()->setCurrentBlock(FuncBB);
+    debugInfo.setLocation(Builder, this->line);
+    index = 0;
     for (auto &Arg : func->args()) {
+        ast::Param *p = argParams[index];
+        int slot = p->entry->getOffset();
         auto *alloca =
             Builder.CreateAlloca(Arg.getType(), nullptr, Arg.getName());
         if (Arg.getType()->isPointerTy())
-            genBlocks.front()->addAddr(Arg.getName(), alloca);
+            genBlocks.front()->addAddr(slot, alloca);
         else
-            genBlocks.front()->addVal(Arg.getName(), alloca);
-        Builder.CreateStore(&Arg, alloca);
+            genBlocks.front()->addVal(slot, alloca);
+        debugInfo.declareParam(alloca, symbolName(p->id), index + 1, p->line,
+                               p->type, p->mode, FuncBB);
+        tbaa(Builder.CreateStore(&Arg, alloca),
+             Arg.getType()->isPointerTy() ? tbaaPointer : tbaaTag(p->type));
+        index++;
     }
     for (auto &decl : this->decls)
         decl->codegen();
+    if (enterHook != nullptr)
+        Builder.CreateCall(enterHook,
+                           std::vector<llvm::Value *>{
+                               c32(this->entry->getOffset()),
+                               Builder.CreateGlobalStringPtr(funcNames.back())});
     this->body->codegen();
 
-    if (func->getReturnType()->isVoidTy())
+    if (func->getReturnType()->isVoidTy()) {
+        codegenEpilogue();
         Builder.CreateRetVoid();
-    else {
+    } else {
         if (!genBlocks.front()->hasReturn()) {
+            codegenEpilogue();
             if (func->getReturnType()->isIntegerTy(32))
                 Builder.CreateRet(c32(0));
             else
@@ -446,8 +649,10 @@ llvm::Value *Func::codegen() {
         }
     }
 
+    funcNames.pop_back();
+
+    debugInfo.closeFunc(Builder);
     genBlocks.pop_front();
-    scopes.closeScope();
 
     if (!main)
         Builder.SetInsertPoint(genBlocks.front()->getCurrentBlock());
@@ -456,15 +661,18 @@ llvm::Value *Func::codegen() {
 }
 
 llvm::Value *Block::codegen() {
-    for (auto &stmt : this->stmts)
+    for (auto &stmt : this->stmts) {
+        debugInfo.setLocation(Builder, stmt->line);
+        codegenCounter(stmt->line);
         stmt->codegen();
+    }
     return nullptr;
 }
 
 } // namespace ast
 
 /**
- * Standard library functions :
+ * Standard library functions ( slots 0 to 13 ) :
  *   - void writeInteger(int n)
  *   - void writeByte(byte b)
  *   - void writeChar(byte b)
@@ -481,90 +689,383 @@ llvm::Value *Block::codegen() {
  *   - void strcat(reference byte trg, reference byte src)
  */
 void codegenLibs() {
+    /* Same order as in Table::addLibs, so that the slots match */
+    int slot = 0;
     auto *writeIntegerType =
         llvm::FunctionType::get(proc, std::vector<llvm::Type *>{i32}, false);
-    scopes.addFunc("writeInteger",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(writeIntegerType,
                                           llvm::Function::ExternalLinkage,
                                           "writeInteger", TheModule.get()));
     auto *writeByteType =
         llvm::FunctionType::get(proc, std::vector<llvm::Type *>{i8}, false);
-    scopes.addFunc("writeByte",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(writeByteType,
                                           llvm::Function::ExternalLinkage,
                                           "writeByte", TheModule.get()));
     auto *writeCharType =
         llvm::FunctionType::get(proc, std::vector<llvm::Type *>{i8}, false);
-    scopes.addFunc("writeChar",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(writeCharType,
                                           llvm::Function::ExternalLinkage,
                                           "writeChar", TheModule.get()));
     auto *writeStringType = llvm::FunctionType::get(
         proc, std::vector<llvm::Type *>{i8->getPointerTo()}, false);
-    scopes.addFunc("writeString",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(writeStringType,
                                           llvm::Function::ExternalLinkage,
                                           "writeString", TheModule.get()));
     auto *readIntegerType =
         llvm::FunctionType::get(i32, std::vector<llvm::Type *>{}, false);
-    scopes.addFunc("readInteger",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(readIntegerType,
                                           llvm::Function::ExternalLinkage,
                                           "readInteger", TheModule.get()));
     auto *readByteType =
         llvm::FunctionType::get(i8, std::vector<llvm::Type *>{}, false);
-    scopes.addFunc("readByte",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(readByteType,
                                           llvm::Function::ExternalLinkage,
                                           "readByte", TheModule.get()));
     auto *readCharType =
         llvm::FunctionType::get(i8, std::vector<llvm::Type *>{}, false);
-    scopes.addFunc("readChar",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(readCharType,
                                           llvm::Function::ExternalLinkage,
                                           "readChar", TheModule.get()));
     auto *readStringType = llvm::FunctionType::get(
         proc, std::vector<llvm::Type *>{i32, i8->getPointerTo()}, false);
-    scopes.addFunc("readString",
+    scopes.addFunc(slot++,
                    llvm::Function::Create(readStringType,
                                           llvm::Function::ExternalLinkage,
                                           "readString", TheModule.get()));
     auto *extendType =
         llvm::FunctionType::get(i32, std::vector<llvm::Type *>{i8}, false);
-    scopes.addFunc("extend", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  extendType, llvm::Function::ExternalLinkage,
                                  "extend", TheModule.get()));
     auto *shrinkType =
         llvm::FunctionType::get(i8, std::vector<llvm::Type *>{i32}, false);
-    scopes.addFunc("shrink", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  shrinkType, llvm::Function::ExternalLinkage,
                                  "shrink", TheModule.get()));
     auto *strlenType = llvm::FunctionType::get(
         i32, std::vector<llvm::Type *>{i8->getPointerTo()}, false);
-    scopes.addFunc("strlen", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  strlenType, llvm::Function::ExternalLinkage,
                                  "strlen", TheModule.get()));
     auto *strcmpType = llvm::FunctionType::get(
         i32, std::vector<llvm::Type *>{i8->getPointerTo(), i8->getPointerTo()},
         false);
-    scopes.addFunc("strcmp", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  strcmpType, llvm::Function::ExternalLinkage,
                                  "strcmp", TheModule.get()));
     auto *strcpyType = llvm::FunctionType::get(
         proc, std::vector<llvm::Type *>{i8->getPointerTo(), i8->getPointerTo()},
         false);
-    scopes.addFunc("strcpy", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  strcpyType, llvm::Function::ExternalLinkage,
                                  "strcpy", TheModule.get()));
     auto *strcatType = llvm::FunctionType::get(
         proc, std::vector<llvm::Type *>{i8->getPointerTo(), i8->getPointerTo()},
         false);
-    scopes.addFunc("strcat", llvm::Function::Create(
+    scopes.addFunc(slot++, llvm::Function::Create(
                                  strcatType, llvm::Function::ExternalLinkage,
                                  "strcat", TheModule.get()));
 }
 
+/**
+ * Functions of imported modules ( slots after the standard library ).
+ * Same order as Table::addImports, so every entry finds its slot.
+ */
+void codegenImports() {
+    for (auto &fun : sem::imports) {
+        std::vector<llvm::Type *> args;
+        for (auto &par : fun->getParams())
+            args.push_back(translateType(par->type, par->getMode()));
+        auto *ftype =
+            llvm::FunctionType::get(translateType(fun->type), args, false);
+        scopes.addFunc(fun->getOffset(),
+                       llvm::Function::Create(ftype,
+                                              llvm::Function::ExternalLinkage,
+                                              symbolName(fun->id),
+                                              TheModule.get()));
+    }
+}
+
+/**
+ * Runtime profiling hooks ( check lib.c ) :
+ *   - void __alan_enter(int id, reference byte name)
+ *   - void __alan_exit()
+ */
+void codegenHooks() {
+    auto *enterType = llvm::FunctionType::get(
+        proc, std::vector<llvm::Type *>{i32, i8->getPointerTo()}, false);
+    enterHook = llvm::Function::Create(enterType,
+                                       llvm::Function::ExternalLinkage,
+                                       "__alan_enter", TheModule.get());
+    auto *exitType =
+        llvm::FunctionType::get(proc, std::vector<llvm::Type *>{}, false);
+    exitHook = llvm::Function::Create(exitType, llvm::Function::ExternalLinkage,
+                                      "__alan_exit", TheModule.get());
+}
+
+/*******************************************************************************
+ * Every return of an instrumented function leaves through the exit hook.
+ *******************************************************************************/
+void codegenExitHook() {
+    if (exitHook != nullptr)
+        Builder.CreateCall(exitHook, std::vector<llvm::Value *>{});
+}
+
+/*******************************************************************************
+ * Emitted before every return : frees the heap frames of the function
+ * ( check codegenArray ), then leaves through the exit hook.
+ *******************************************************************************/
+void codegenEpilogue() {
+    for (auto *heap : genBlocks.front()->getHeaps())
+        Builder.CreateCall(heapFree, std::vector<llvm::Value *>{heap});
+    codegenExitHook();
+}
+
+/*******************************************************************************
+ * Storage of local arrays :
+ *   - up to `--stack-array-limit` bytes they stay on the stack
+ *   - bigger ones of non recursive functions go in a zero-initialized
+ *   > internal global, since only one activation can use it at a time
+ *   - bigger ones of recursive functions get a heap frame from the runtime,
+ *   > freed by the epilogue of the function
+ * Stack arrays are aligned for AVX loads, the others to a cache line.
+ *******************************************************************************/
+llvm::Value *codegenArray(sem::TypePtr type, const std::string &name) {
+    auto *arrayType = translateType(type);
+    uint64_t elemSize =
+        type->getRef()->t == sem::genType::INT ? INT_SIZE : BYTE_SIZE;
+    uint64_t bytes = elemSize * type->getSize();
+    if (bytes <= options.stackArrayLimit) {
+        auto *alloca = Builder.CreateAlloca(arrayType, nullptr, name);
+        alloca->setAlignment(STACK_ARRAY_ALIGN);
+        return alloca;
+    }
+    if (!genBlocks.front()->isRecursive()) {
+        auto *global = new llvm::GlobalVariable(
+            *TheModule, arrayType, false, llvm::GlobalValue::InternalLinkage,
+            llvm::ConstantAggregateZero::get(arrayType),
+            funcNames.back() + "." + name);
+        global->setAlignment(BIG_ARRAY_ALIGN);
+        return global;
+    }
+    if (heapAlloc == nullptr) {
+        auto *allocType = llvm::FunctionType::get(
+            i8->getPointerTo(),
+            std::vector<llvm::Type *>{i64}, false);
+        heapAlloc = llvm::Function::Create(allocType,
+                                           llvm::Function::ExternalLinkage,
+                                           "__alan_alloc", TheModule.get());
+        auto *freeType = llvm::FunctionType::get(
+            proc, std::vector<llvm::Type *>{i8->getPointerTo()}, false);
+        heapFree = llvm::Function::Create(freeType,
+                                          llvm::Function::ExternalLinkage,
+                                          "__alan_free", TheModule.get());
+    }
+    auto *heap = Builder.CreateCall(
+        heapAlloc, std::vector<llvm::Value *>{Builder.getInt64(bytes)});
+    genBlocks.front()->addHeap(heap);
+    return Builder.CreateBitCast(heap, arrayType->getPointerTo(), name);
+}
+
+/*******************************************************************************
+ * Adds one to a new counter for `line`.
+ *******************************************************************************/
+void codegenCounter(int line) {
+    if (counters == nullptr)
+        return;
+    auto *ptr = Builder.CreateConstInBoundsGEP2_64(counters, 0,
+                                                   counterLines.size());
+    counterLines.push_back(line);
+    auto *count = tbaa(Builder.CreateLoad(ptr), tbaaCounter);
+    tbaa(Builder.CreateStore(Builder.CreateAdd(count, c64(1)), ptr),
+         tbaaCounter);
+}
+
+/**
+ * Coverage runtime ( check lib.c ) :
+ *   - void __alan_coverage(reference byte source, int n,
+ *                          reference int lines, reference int64 counts)
+ * Creates the real counter and line arrays, and registers them from main.
+ */
+void codegenCoverage() {
+    int n = counterLines.size();
+    auto *countsType = llvm::ArrayType::get(i64, n);
+    auto *counts = new llvm::GlobalVariable(
+        *TheModule, countsType, false, llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantAggregateZero::get(countsType), "__alan_counts");
+    counters->replaceAllUsesWith(
+        llvm::ConstantExpr::getBitCast(counts, counters->getType()));
+    counters->eraseFromParent();
+    counters = nullptr;
+
+    std::vector<llvm::Constant *> lines;
+    for (int line : counterLines)
+        lines.push_back(c32(line));
+    auto *linesType = llvm::ArrayType::get(i32, n);
+    auto *linesVar = new llvm::GlobalVariable(
+        *TheModule, linesType, true, llvm::GlobalValue::PrivateLinkage,
+        llvm::ConstantArray::get(linesType, lines), "__alan_lines");
+
+    auto *coverageType = llvm::FunctionType::get(
+        proc,
+        std::vector<llvm::Type *>{i8->getPointerTo(), i32,
+                                  i32->getPointerTo(), i64->getPointerTo()},
+        false);
+    auto *coverage = llvm::Function::Create(
+        coverageType, llvm::Function::ExternalLinkage, "__alan_coverage",
+        TheModule.get());
+    llvm::SmallString<128> source(filename);
+    llvm::sys::fs::make_absolute(source);
+    Builder.CreateCall(
+        coverage,
+        std::vector<llvm::Value *>{
+            Builder.CreateGlobalStringPtr(source.str()), c32(n),
+            Builder.CreateConstInBoundsGEP2_64(linesVar, 0, 0),
+            Builder.CreateConstInBoundsGEP2_64(counts, 0, 0)});
+}
+
+/*******************************************************************************
+ * Array indices are sign-extended to i64 ( pointer width ) before the GEP.
+ * Accesses out of bounds are undefined, so all array GEPs are `inbounds`.
+ * With `nsw` index arithmetic, indvars widens the induction variable and
+ * the extension leaves the loop body.
+ *******************************************************************************/
+llvm::Value *codegenIndex(ast::astPtr index) {
+    return Builder.CreateSExt(index->codegen(), i64, "idx");
+}
+
+/*******************************************************************************
+ * Sets the triple and data layout of the module, so that opt knows the
+ * target ( type sizes, vector widths ) instead of assuming a generic one.
+ * The cpu and features come from -mcpu / -march=native.
+ *******************************************************************************/
+void codegenTarget() {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    std::string triple = options.target.empty()
+                             ? llvm::sys::getDefaultTargetTriple()
+                             : llvm::Triple::normalize(options.target);
+    std::string err;
+    auto *target = llvm::TargetRegistry::lookupTarget(triple, err);
+    if (target == nullptr)
+        fatal("Unknown target ", triple, ": ", err);
+    if (options.nativeArch) {
+        targetCPU = llvm::sys::getHostCPUName();
+        llvm::StringMap<bool> host;
+        llvm::SubtargetFeatures features;
+        if (llvm::sys::getHostCPUFeatures(host))
+            for (auto &feature : host)
+                features.AddFeature(feature.first(), feature.second);
+        targetFeatures = features.getString();
+    } else if (!options.cpu.empty()) {
+        targetCPU = options.cpu;
+    }
+    llvm::TargetOptions opts;
+    std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+        triple, targetCPU, targetFeatures, opts,
+        llvm::Optional<llvm::Reloc::Model>()));
+    TheModule->setTargetTriple(triple);
+    TheModule->setDataLayout(machine->createDataLayout());
+}
+
+void setTargetAttributes(llvm::Function *func) {
+    if (!targetCPU.empty())
+        func->addFnAttr("target-cpu", targetCPU);
+    if (!targetFeatures.empty())
+        func->addFnAttr("target-features", targetFeatures);
+}
+
+/*******************************************************************************
+ * TBAA type tree ( all children of the root never alias each other ) :
+ *   - int, byte : scalars and array elements of that type
+ *   - pointer   : the stack slots holding reference parameters
+ *   - counter   : coverage counters
+ * Alan has no casts or unions, so an int store can never change a byte
+ * ( and vice versa ), and a store to an element never changes a reference.
+ *******************************************************************************/
+void codegenTBAA() {
+    llvm::MDBuilder MDB(TheContext);
+    auto *root = MDB.createTBAARoot("Alan TBAA");
+    auto node = [&](const char *name) {
+        auto *type = MDB.createTBAAScalarTypeNode(name, root);
+        return MDB.createTBAAStructTagNode(type, type, 0);
+    };
+    tbaaInt = node("int");
+    tbaaByte = node("byte");
+    tbaaPointer = node("pointer");
+    tbaaCounter = node("counter");
+}
+
+/*******************************************************************************
+ * Accesses through arrays are tagged with the type of their elements.
+ *******************************************************************************/
+llvm::MDNode *tbaaTag(sem::TypePtr type) {
+    switch (type->t) {
+    case sem::genType::INT:
+        return tbaaInt;
+    case sem::genType::BYTE:
+        return tbaaByte;
+    case sem::genType::ARRAY:
+    case sem::genType::IARRAY:
+        return tbaaTag(type->getRef());
+    default:
+        return nullptr;
+    }
+}
+
+llvm::Value *tbaa(llvm::Instruction *inst, llvm::MDNode *tag) {
+    if (tag != nullptr)
+        inst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    return inst;
+}
+
+/*******************************************************************************
+ * Loads the address held by the stack slot of a reference parameter.
+ *******************************************************************************/
+llvm::Value *loadAddr(int slot) {
+    return tbaa(Builder.CreateLoad(genBlocks.front()->getAddr(slot)),
+                tbaaPointer);
+}
+
+/*******************************************************************************
+ * Emits a condition and turns it into the i1 needed by branches.
+ * Conditions may be i1 (comparisons) or i8/i32 (true, false, &, |, !).
+ *******************************************************************************/
+llvm::Value *codegenCond(ast::astPtr cond) {
+    auto *CondV = cond->codegen();
+    if (!CondV->getType()->isIntegerTy(32)) {
+        CondV = Builder.CreateZExt(CondV, i32);
+    }
+    return Builder.CreateICmpEQ(CondV, c32(1));
+}
+
+/*******************************************************************************
+ * Types are interned, so the translation of each one is cached by its index.
+ *******************************************************************************/
+static std::vector<llvm::Type *> typeCache;
+
 llvm::Type *translateType(sem::TypePtr type, sem::PassMode mode) {
+    if (type->index >= typeCache.size())
+        typeCache.resize(sem::typeCount(), nullptr);
+    llvm::Type *ret = typeCache[type->index];
+    if (ret == nullptr) {
+        ret = translateBaseType(type);
+        typeCache[type->index] = ret;
+    }
+    if (mode == sem::PassMode::REFERENCE)
+        ret = ret->getPointerTo();
+    return ret;
+}
+
+static llvm::Type *translateBaseType(sem::TypePtr type) {
     llvm::Type *ret;
     switch (type->t) {
     case sem::genType::INT:
@@ -584,7 +1085,5 @@ llvm::Type *translateType(sem::TypePtr type, sem::PassMode mode) {
         ret = translateType(type->getRef());
         break;
     }
-    if (mode == sem::PassMode::REFERENCE)
-        ret = ret->getPointerTo();
     return ret;
 }
@@ -13,37 +13,149 @@
 #include <message/message.hpp>
 #include <ast/ast.hpp>
 #include <general/general.hpp>
+#include <general/arena.hpp>
+#include <options/options.hpp>
+#include <symbol/interface.hpp>
 
 #include <iostream>
 #include <vector>
 
-static Debugger debugger;
-
 /*******************************************************************************
  * Perform semantic analysis for the AST.
  * Calls semantic function for all nodes.
  * Every node of the ast does something different to check semantic.
- * Also can print AST via the Debugger class.
+ * The checked ast can be printed with --dump-ast ( check dump.cpp ).
  *******************************************************************************/
 
 namespace ast {
 
 static bool first = true;
 
-astVecMap hiddenMap;
+/**
+ * Function whose calls are being fixed
+ */
+static Func *fixing = nullptr;
+
+/*******************************************************************************
+ ********************************** Dispatch ***********************************
+ *******************************************************************************/
 
+void Node::semantic(sem::Table &symtable) {
+    switch ( this->kind ) {
+        case NodeKind::INT :
+            static_cast<Int *>(this)->semantic(symtable);
+            return;
+        case NodeKind::BYTE :
+            static_cast<Byte *>(this)->semantic(symtable);
+            return;
+        case NodeKind::STRING :
+            static_cast<String *>(this)->semantic(symtable);
+            return;
+        case NodeKind::VAR :
+            static_cast<Var *>(this)->semantic(symtable);
+            return;
+        case NodeKind::BINOP :
+            static_cast<BinOp *>(this)->semantic(symtable);
+            return;
+        case NodeKind::CONDITION :
+            static_cast<Condition *>(this)->semantic(symtable);
+            return;
+        case NodeKind::IFELSE :
+            static_cast<IfElse *>(this)->semantic(symtable);
+            return;
+        case NodeKind::WHILE :
+            static_cast<While *>(this)->semantic(symtable);
+            return;
+        case NodeKind::CALL :
+            static_cast<Call *>(this)->semantic(symtable);
+            return;
+        case NodeKind::RET :
+            static_cast<Ret *>(this)->semantic(symtable);
+            return;
+        case NodeKind::ASSIGN :
+            static_cast<Assign *>(this)->semantic(symtable);
+            return;
+        case NodeKind::VARDECL :
+            static_cast<VarDecl *>(this)->semantic(symtable);
+            return;
+        case NodeKind::PARAM :
+            static_cast<Param *>(this)->semantic(symtable);
+            return;
+        case NodeKind::FUNC :
+            static_cast<Func *>(this)->semantic(symtable);
+            return;
+        case NodeKind::BLOCK :
+            static_cast<Block *>(this)->semantic(symtable);
+            return;
+    }
+}
+
+/*******************************************************************************
+ * Only calls and the statements that can contain them have work to do.
+ *******************************************************************************/
 void Node::fixCalls() {
-    return;
+    switch ( this->kind ) {
+        case NodeKind::VAR : {
+            auto *var = static_cast<Var *>(this);
+            if ( var->index != nullptr )
+                var->index->fixCalls();
+            return;
+        }
+        case NodeKind::BINOP : {
+            auto *binop = static_cast<BinOp *>(this);
+            binop->left->fixCalls();
+            binop->right->fixCalls();
+            return;
+        }
+        case NodeKind::CONDITION : {
+            auto *cond = static_cast<Condition *>(this);
+            if ( cond->left != nullptr )
+                cond->left->fixCalls();
+            cond->right->fixCalls();
+            return;
+        }
+        case NodeKind::IFELSE : {
+            auto *ifelse = static_cast<IfElse *>(this);
+            ifelse->cond->fixCalls();
+            ifelse->ifBody->fixCalls();
+            if ( ifelse->elseBody != nullptr )
+                ifelse->elseBody->fixCalls();
+            return;
+        }
+        case NodeKind::WHILE : {
+            auto *loop = static_cast<While *>(this);
+            loop->cond->fixCalls();
+            loop->body->fixCalls();
+            return;
+        }
+        case NodeKind::RET :
+            static_cast<Ret *>(this)->expr->fixCalls();
+            return;
+        case NodeKind::ASSIGN : {
+            auto *assign = static_cast<Assign *>(this);
+            assign->left->fixCalls();
+            assign->right->fixCalls();
+            return;
+        }
+        case NodeKind::CALL :
+            static_cast<Call *>(this)->fixCalls();
+            return;
+        case NodeKind::FUNC :
+            static_cast<Func *>(this)->fixCalls();
+            return;
+        case NodeKind::BLOCK :
+            static_cast<Block *>(this)->fixCalls();
+            return;
+        default :
+            return;
+    }
 }
 
 /*******************************************************************************
  ****************************** Integer Constants ******************************
  *******************************************************************************/
 
-void Int::semantic(sem::SymbolTable symtable) {
-    debugger.newLevel();
-    debugger.show("<Integer, ", this->val, ">");
-    debugger.restoreLevel();
+void Int::semantic(sem::Table &symtable) {
     return;
 }
 
@@ -51,10 +163,7 @@ void Int::semantic(sem::SymbolTable symtable) {
  ******************************* Byte Constants ********************************
  *******************************************************************************/
 
-void Byte::semantic(sem::SymbolTable symtable) {
-    debugger.newLevel();
-    debugger.show("<Byte, ", (int)this->b, ">");
-    debugger.restoreLevel();
+void Byte::semantic(sem::Table &symtable) {
     return;
 }
 
@@ -62,10 +171,7 @@ void Byte::semantic(sem::SymbolTable symtable) {
  ******************************* String Literals *******************************
  *******************************************************************************/
 
-void String::semantic(sem::SymbolTable symtable) {
-    debugger.newLevel();
-    debugger.show("<String Literal, ", this->s, ">");
-    debugger.restoreLevel();
+void String::semantic(sem::Table &symtable) {
     return;
 }
 
@@ -73,9 +179,8 @@ void String::semantic(sem::SymbolTable symtable) {
  ********************************** Variables **********************************
  *******************************************************************************/
 
-void Var::semantic(sem::SymbolTable symtable) {
+void Var::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
     /* Array Variable */
     if ( this->index != nullptr ) {
         this->index->semantic(symtable);
@@ -87,17 +192,21 @@ void Var::semantic(sem::SymbolTable symtable) {
     /**
      * Find corresponding table entry
      */
-    auto entry = symtable->lookupEntry(this->id, sem::Lookup::ALL, true);
+    const auto& entry = symtable.lookupEntry(this->id, sem::Lookup::ALL, true);
     if ( entry->eType == sem::EntryType::FUNCTION ) {
         error("Not a variable/parameter");
         return;
     }
     /**
      * If not found in current scope then add
-     * as hidden variable for all previous functions
+     * as hidden variable for all previous functions.
+     * The variable is bound to the hidden parameter
+     * of the current function.
      */
-    if ( entry->nestingLevel < symtable->getScope()->nestingLevel) {
-        symtable->addHidden(entry);
+    if ( entry->nestingLevel < symtable.getScope()->nestingLevel) {
+        this->entry = symtable.addHidden(entry);
+    } else {
+        this->entry = entry;
     }
     /**
      * Fix type of variable
@@ -105,22 +214,18 @@ void Var::semantic(sem::SymbolTable symtable) {
      *   if array get refType
      */
     if ( this->index == nullptr ) {
-        this->type = entry->type;
+        this->type = this->entry->type;
     } else {
-        this->type = entry->type->getRef();
+        this->type = this->entry->type->getRef();
     }
-    debugger.show("<Var, ", this->id, ", ", *this->type, ">");
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  ****************************** Binary Operations ******************************
  *******************************************************************************/
 
-void BinOp::semantic(sem::SymbolTable symtable) {
+void BinOp::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<BinOp>");
     /**
      * Perform semantic analysis
      * of the two operands
@@ -136,17 +241,14 @@ void BinOp::semantic(sem::SymbolTable symtable) {
         return;
     }
     this->type = this->left->type;
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  ********************************* Conditions **********************************
  *******************************************************************************/
 
-void Condition::semantic(sem::SymbolTable symtable) {
+void Condition::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<Condition>");
     switch(this->op) {
         case Cond::NOT :
             this->right->semantic(symtable);
@@ -182,17 +284,14 @@ void Condition::semantic(sem::SymbolTable symtable) {
             this->type = sem::typeByte;
             break;
     }
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  *********************************** IfElse ************************************
  *******************************************************************************/
 
-void IfElse::semantic(sem::SymbolTable symtable) {
+void IfElse::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<IfElse>");
     /**
      * Perform semantic analysis in the order :
      *   - condition (performs necessary checks)
@@ -208,17 +307,14 @@ void IfElse::semantic(sem::SymbolTable symtable) {
     if ( this->elseBody != nullptr ) {
         this->elseBody->semantic(symtable);
     }
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  ************************************ While ************************************
  *******************************************************************************/
 
-void While::semantic(sem::SymbolTable symtable) {
+void While::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<While>");
     /**
      * Perform semantic analysis in the order :
      *   - condition
@@ -230,22 +326,20 @@ void While::semantic(sem::SymbolTable symtable) {
         return;
     }
     this->body->semantic(symtable);
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  ******************************** Function Call ********************************
  *******************************************************************************/
 
-void Call::semantic(sem::SymbolTable symtable) {
+void Call::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<FunctionCall, ", this->id, ">");
-    auto entry = symtable->lookupEntry(this->id, sem::Lookup::ALL, true);
+    const auto& entry = symtable.lookupEntry(this->id, sem::Lookup::ALL, true);
     if ( entry->eType != sem::EntryType::FUNCTION ) {
-        error(this->id, " is not a function");
+        error(symbolName(this->id), " is not a function");
         return;
     }
+    this->entry = entry;
     /**
      * Check number of params
      */
@@ -259,7 +353,7 @@ void Call::semantic(sem::SymbolTable symtable) {
     /**
      * Complete semantic analysis of given parameters
      */
-    for ( auto p : this->params ) {
+    for ( auto& p : this->params ) {
         p->semantic(symtable);
     }
     /**
@@ -268,19 +362,29 @@ void Call::semantic(sem::SymbolTable symtable) {
     auto& pars = entry->getParams();
     for ( int i = 0; i < this->params.size(); i++ ) {
         if ( !sem::compatibleType(this->params[i]->type, pars[i]->type) ) {
-            error("Type mismatch in parameter ", pars[i]->id, "\nExpected ", this->params[i]->type);
+            error("Type mismatch in parameter ", symbolName(pars[i]->id), "\nExpected ", this->params[i]->type);
             return;
         }
     }
     this->type = entry->type;
-    debugger.restoreLevel();
+    symtable.getScope()->getFunction()->addCall(entry);
 }
 
+/*******************************************************************************
+ * Hidden parameters of the called function are only complete after the whole
+ * program is analysed, so they are turned into arguments here.
+ *******************************************************************************/
 void Call::fixCalls() {
-    for ( auto hid : hiddenMap[this->id] ) {
-        auto temp = std::dynamic_pointer_cast<Param>(hid);
-        auto v = newShared<Var>(temp->id, nullptr);
-        v->type = temp->type;
+    for ( auto p : this->params )
+        p->fixCalls();
+    for ( auto& hid : this->entry->getHidden() ) {
+        auto v = newNode<Var>(hid->id, nullptr);
+        v->type  = hid->type;
+        v->entry = fixing->binding(hid->id);
+        if ( v->entry == nullptr ) {
+            linecount = this->line;
+            internal("Cannot pass hidden parameter ", symbolName(hid->id));
+        }
         this->hidden.push_back(v);
     }
 }
@@ -289,28 +393,27 @@ void Call::fixCalls() {
  ****************************** Function Returns *******************************
  *******************************************************************************/
 
-void Ret::semantic(sem::SymbolTable symtable) {
+void Ret::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<Return>");
     this->expr->semantic(symtable);
     this->type = this->expr->type;
-    if ( !sem::compatibleType(this->type, symtable->scopeType()) ) {
+    if ( !sem::compatibleType(this->type, symtable.scopeType()) ) {
         error("Type mismatch in function return");
         return;
     }
-    symtable->addReturn();
-    debugger.restoreLevel();
+    symtable.addReturn();
 }
 
 /*******************************************************************************
  ********************************* Assignments *********************************
  *******************************************************************************/
 
-void Assign::semantic(sem::SymbolTable symtable) {
+void Assign::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<Assignment>");
+    if ( nodeCast<Var>(this->left) == nullptr ) {
+        error("Cannot assign to a string literal");
+        return;
+    }
     this->left->semantic(symtable);
     this->right->semantic(symtable);
     if ( !sem::equalType(this->left->type, this->right->type) ) {
@@ -318,98 +421,108 @@ void Assign::semantic(sem::SymbolTable symtable) {
         return;
     }
     this->type = this->left->type;
-    debugger.restoreLevel();
 }
 
 /*******************************************************************************
  **************************** Variable Declarations ****************************
  *******************************************************************************/
 
-void VarDecl::semantic(sem::SymbolTable symtable) {
+void VarDecl::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<VarDecl, ", this->id, ", ", *this->type, ">");
-    auto entry = symtable->lookupEntry(this->id, sem::Lookup::CURRENT, false);
-    if ( entry != nullptr ) {
-        error("Duplicate identifier ", this->id);
+    if ( symtable.lookupEntry(this->id, sem::Lookup::CURRENT, false) != nullptr ) {
+        error("Duplicate identifier ", symbolName(this->id));
         return;
     }
-    symtable->insertEntry(newShared<sem::EntryVariable>(this->id, this->type));
-    debugger.restoreLevel();
+    this->entry = newShared<sem::EntryVariable>(this->id, this->type);
+    symtable.insertEntry(this->entry);
 }
 
 /*******************************************************************************
  ********************************* Parameters **********************************
  *******************************************************************************/
 
-void Param::semantic(sem::SymbolTable symtable) {
+void Param::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<Parameter, ", this->id, ", ", *this->type, ">");
-    auto p = newShared<sem::EntryParameter>(this->id, this->type, this->mode);
-    symtable->insertEntry(p);
-    symtable->addParam(p);
-    debugger.restoreLevel();
+    this->entry = newShared<sem::EntryParameter>(this->id, this->type, this->mode);
+    symtable.insertEntry(this->entry);
+    symtable.addParam(this->entry);
 }
 
 /*******************************************************************************
  ********************************** Functions **********************************
  *******************************************************************************/
 
-void Func::semantic(sem::SymbolTable symtable) {
+void Func::semantic(sem::Table &symtable) {
     if ( ast::first ) {
         this->main = true;
         ast::first = false;
     }
-    if ( !this->main ) {
-        debugger.newLevel();
-    }
     linecount = this->line;
-    debugger.show("<Function Declaration, ", this->id, ", ", *this->type, ">");
-    auto entry = symtable->lookupEntry(this->id, sem::Lookup::CURRENT, false);
-    if ( entry != nullptr ) {
-        error("Duplicate identifier ", this->id);
+    if ( symtable.lookupEntry(this->id, sem::Lookup::CURRENT, false) != nullptr ) {
+        error("Duplicate identifier ", symbolName(this->id));
         return;
     }
     auto fun = newShared<sem::EntryFunction>(this->id, this->type);
-    symtable->insertEntry(fun);
-    symtable->openScope(fun);
-    for ( auto p : this->params ) {
+    symtable.insertEntry(fun);
+    this->entry = fun;
+    symtable.openScope(fun);
+    for ( auto& p : this->params ) {
         p->semantic(symtable);
     }
     for ( auto d : this->decls ) {
         d->semantic(symtable);
     }
     this->body->semantic(symtable);
-    entry = symtable->lookupEntry(this->id, sem::Lookup::ALL, false);
-    for ( auto hid : entry->getHidden() ) {
-        this->hidden.push_back(newShared<Param>(hid->id, sem::PassMode::REFERENCE, hid->type));
-    }
-    symtable->closeScope();
-    if ( !this->main ) {
-        debugger.restoreLevel();
+    /**
+     * Hidden parameters are bound to the entries
+     * this scope got for them ( check addHidden )
+     */
+    for ( auto& hid : fun->getHidden() ) {
+        auto h = newNode<Param>(hid->id, sem::PassMode::REFERENCE, hid->type);
+        h->entry = symtable.lookupEntry(hid->id, sem::Lookup::CURRENT, true);
+        this->hidden.push_back(h);
     }
+    symtable.closeScope();
 }
 
 void Func::fixCalls() {
-    hiddenMap[this->id] = this->hidden;
     for ( auto d : this->decls )
         d->fixCalls();
+    auto *previous = fixing;
+    fixing = this;
     this->body->fixCalls();
+    fixing = previous;
+}
+
+/*******************************************************************************
+ * Finds the entry a name is bound to inside this function
+ * ( parameter, hidden parameter or local variable ).
+ * Used once per hidden argument, never per access.
+ *******************************************************************************/
+sem::EntryPtr Func::binding(SymbolId id) {
+    for ( auto p : this->params )
+        if ( static_cast<Param *>(p)->id == id )
+            return static_cast<Param *>(p)->entry;
+    for ( auto h : this->hidden )
+        if ( static_cast<Param *>(h)->id == id )
+            return static_cast<Param *>(h)->entry;
+    for ( auto d : this->decls ) {
+        auto v = nodeCast<VarDecl>(d);
+        if ( v != nullptr && v->id == id )
+            return v->entry;
+    }
+    return nullptr;
 }
 
 /*******************************************************************************
  ***************************** Compound Statements *****************************
  *******************************************************************************/
 
-void Block::semantic(sem::SymbolTable symtable) {
+void Block::semantic(sem::Table &symtable) {
     linecount = this->line;
-    debugger.newLevel();
-    debugger.show("<Block Statement>");
     for ( auto s : this->stmts ) {
         s->semantic(symtable);
     }
-    debugger.restoreLevel();
     return;
 }
 
@@ -424,8 +537,12 @@ void Block::fixCalls() {
 
 void semantic(astPtr root) {
     auto symtable = sem::initSymbolTable();
-    root->semantic(symtable);
+    root->semantic(*symtable);
     root->fixCalls();
+    if ( !options.interface.empty() ) {
+        auto *program = static_cast<Func *>(root);
+        sem::writeInterface(options.interface.c_str(), program->entry);
+    }
     return;
 }
 
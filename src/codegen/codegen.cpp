@@ -25,6 +25,7 @@ GenBlock::GenBlock() {
     this->func      = nullptr;
     this->currentBB = nullptr;
     this->hasRet    = false;
+    this->recursive = true;
 }
 
 GenBlock::~GenBlock() {
@@ -39,52 +40,78 @@ void GenBlock::setCurrentBlock(llvm::BasicBlock *BB) {
     this->hasRet    = false;
 }
 
-void GenBlock::addArg(std::string name, sem::TypePtr type, sem::PassMode mode) {
+/*******************************************************************************
+ * Slots are dense, so tables simply grow to the biggest slot seen.
+ *******************************************************************************/
+template<typename T>
+static inline void setSlot(std::vector<T> &table, int slot, T value) {
+    if (slot >= table.size())
+        table.resize(slot + 1, nullptr);
+    table[slot] = value;
+}
+
+void GenBlock::addArg(int slot, sem::TypePtr type, sem::PassMode mode) {
     auto *t = translateType(type, mode);
     args.push_back(t);
-    vars[name] = t;
+    setSlot(vars, slot, t);
 }
 
-void GenBlock::addVar(std::string name, sem::TypePtr type, sem::PassMode mode) {
-    vars[name] = translateType(type, mode);
+void GenBlock::addVar(int slot, sem::TypePtr type, sem::PassMode mode) {
+    setSlot(vars, slot, translateType(type, mode));
 }
 
-void GenBlock::addVal(std::string name, llvm::AllocaInst *val) {
-    this->vals[name] = val;
+void GenBlock::addVal(int slot, llvm::Value *val) {
+    setSlot(this->vals, slot, val);
 }
 
-void GenBlock::addAddr(std::string name, llvm::AllocaInst *addr) {
-    this->addrs[name] = addr;
+void GenBlock::addAddr(int slot, llvm::AllocaInst *addr) {
+    setSlot(this->addrs, slot, addr);
+}
+
+void GenBlock::addHeap(llvm::Value *heap) {
+    this->heaps.push_back(heap);
 }
 
 void GenBlock::addRet() {
     this->hasRet = true;
 }
 
+void GenBlock::setRecursive(bool recursive) {
+    this->recursive = recursive;
+}
+
 const TypeVec& GenBlock::getArgs() const {
     return this->args;
 }
 
-llvm::Type* GenBlock::getVar(std::string name) {
-    return this->vars[name];
+llvm::Type* GenBlock::getVar(int slot) const {
+    return this->vars[slot];
 }
 
-llvm::AllocaInst* GenBlock::getVal(std::string name) {
-    return this->vals[name];
+llvm::Value* GenBlock::getVal(int slot) const {
+    return this->vals[slot];
 }
 
-llvm::AllocaInst* GenBlock::getAddr(std::string name) {
-    return this->addrs[name];
+llvm::AllocaInst* GenBlock::getAddr(int slot) const {
+    return this->addrs[slot];
 }
 
-bool GenBlock::isRef(std::string name) {
-    return this->vars[name]->isPointerTy();
+const ValTable& GenBlock::getHeaps() const {
+    return this->heaps;
+}
+
+bool GenBlock::isRef(int slot) const {
+    return this->vars[slot]->isPointerTy();
 }
 
 bool GenBlock::hasReturn() {
     return this->hasRet;
 }
 
+bool GenBlock::isRecursive() const {
+    return this->recursive;
+}
+
 llvm::Function* GenBlock::getFunc() {
     return this->func;
 }
@@ -101,25 +128,10 @@ GenScope::GenScope() {  }
 
 GenScope::~GenScope() {  }
 
-void GenScope::openScope() {
-    this->functions.push_front(FuncMap());
-}
-
-void GenScope::closeScope() {
-    if (this->functions.empty()) {
-        warning("No scopes to close");
-        return;
-    }
-    this->functions.pop_front();
-}
-
-void GenScope::addFunc(std::string id, llvm::Function *func) {
-    this->functions.front()[id] = func;
+void GenScope::addFunc(int slot, llvm::Function *func) {
+    setSlot(this->functions, slot, func);
 }
 
-llvm::Function* GenScope::getFunc(std::string id) {
-    for (auto funcs : this->functions) {
-        if (funcs.find(id) != funcs.end())
-            return funcs[id];
-    }
+llvm::Function* GenScope::getFunc(int slot) const {
+    return this->functions[slot];
 }
@@ -15,7 +15,7 @@
 
 #include <memory>
 #include <deque>
-#include <unordered_map>
+#include <vector>
 
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/BasicBlock.h>
@@ -30,9 +30,14 @@
  *   > BasicBlock of the previous function so that we can continue to emit code
  *   > there after finishing up here
  * FuncMap :
- *   - used to fetch Function* for the "active" functions.
+ *   - used to fetch Function* of every function by its slot.
  *   > This will help us check which arguments need to be passed by reference
  *   > so that we know a var is needed to be passed there.
+ *
+ * Slots :
+ *   - Semantic analysis gives every variable / parameter a dense slot in its
+ *   > function ( the entry offset ) and every function a dense slot in the
+ *   > program, so all tables here are plain vectors indexed by slot.
  *******************************************************************************/
 
 /*******************************************************************************
@@ -45,12 +50,13 @@ class GenBlock;
  ********************************** Typedefs ***********************************
  *******************************************************************************/
 
-typedef std::unordered_map<std::string, llvm::AllocaInst*> ValTable;
+typedef std::vector<llvm::Value*> ValTable;
+typedef std::vector<llvm::AllocaInst*> AddrTable;
 typedef std::shared_ptr<GenBlock> GenPtr;
 typedef std::deque<GenPtr> GenStack;
-typedef std::unordered_map<std::string, llvm::Function*> FuncMap;
+typedef std::vector<llvm::Function*> FuncMap;
 typedef std::vector<llvm::Type*> TypeVec;
-typedef std::unordered_map<std::string, llvm::Type*> TypeTable;
+typedef std::vector<llvm::Type*> TypeTable;
 
 /*******************************************************************************
  * GenBlock Class
@@ -64,9 +70,14 @@ typedef std::unordered_map<std::string, llvm::Type*> TypeTable;
  *     > Useful to know when we have referenced variables
  *     > ( as parameters that is ).
  *   - vals :
- *     > Used to hold values of AllocaInst.
+ *     > Used to hold the storage of values ( an AllocaInst, or for big
+ *     > arrays a global or a heap frame, check VarDecl::codegen ).
  *   - addrs :
  *     > Used to hold addresses of referenced values.
+ *   - heaps :
+ *     > Heap frames of big arrays, freed on every return of the function.
+ *   - recursive :
+ *     > Whether the function may have more than one activation alive.
  *   - currentBB :
  *     > The currentBasicBlock for this function.
  *******************************************************************************/
@@ -76,9 +87,11 @@ class GenBlock {
         TypeVec           args;
         TypeTable         vars;
         ValTable          vals;
-        ValTable          addrs;
+        AddrTable         addrs;
+        ValTable          heaps;
         llvm::BasicBlock *currentBB;
         bool              hasRet;
+        bool              recursive;
     public :
         GenBlock();
         ~GenBlock();
@@ -86,18 +99,22 @@ class GenBlock {
         void setFunc(llvm::Function *func);
         void setCurrentBlock(llvm::BasicBlock *BB);
 
-        void addArg(std::string name, sem::TypePtr type, sem::PassMode mode);
-        void addVar(std::string name, sem::TypePtr type, sem::PassMode mode = sem::PassMode::VALUE);
-        void addVal(std::string name, llvm::AllocaInst *val);
-        void addAddr(std::string name, llvm::AllocaInst *addr);
+        void addArg(int slot, sem::TypePtr type, sem::PassMode mode);
+        void addVar(int slot, sem::TypePtr type, sem::PassMode mode = sem::PassMode::VALUE);
+        void addVal(int slot, llvm::Value *val);
+        void addAddr(int slot, llvm::AllocaInst *addr);
+        void addHeap(llvm::Value *heap);
         void addRet();
+        void setRecursive(bool recursive);
 
         const TypeVec& getArgs() const;
-        llvm::Type* getVar(std::string name);
-        llvm::AllocaInst* getVal(std::string name);
-        llvm::AllocaInst* getAddr(std::string name);
-        bool isRef(std::string name);
+        llvm::Type* getVar(int slot) const;
+        llvm::Value* getVal(int slot) const;
+        llvm::AllocaInst* getAddr(int slot) const;
+        const ValTable& getHeaps() const;
+        bool isRef(int slot) const;
         bool hasReturn();
+        bool isRecursive() const;
 
         llvm::Function* getFunc();
         llvm::BasicBlock* getCurrentBlock();
@@ -105,15 +122,13 @@ class GenBlock {
 
 class GenScope {
     private:
-        std::deque<FuncMap> functions;
+        FuncMap functions;
     public:
         GenScope();
         ~GenScope();
 
-        void openScope();
-        void closeScope();
-        void addFunc(std::string id, llvm::Function *func);
-        llvm::Function* getFunc(std::string id);
+        void addFunc(int slot, llvm::Function *func);
+        llvm::Function* getFunc(int slot) const;
 };
 
 extern llvm::Type* translateType(sem::TypePtr type, sem::PassMode mode = sem::PassMode::VALUE);
@@ -0,0 +1,197 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : debug.cpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Debug information source file (llvm stuff)                   *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <codegen/debug.hpp>
+#include <message/message.hpp>
+
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/Support/Path.h>
+
+GenDebug::GenDebug() {
+    this->unit = nullptr;
+    this->file = nullptr;
+    this->pointerBits = 64;
+    this->linesOnly = false;
+}
+
+GenDebug::~GenDebug() {
+}
+
+/*******************************************************************************
+ * Alan has no DWARF language code. Pascal is the closest one
+ * ( nested procedures, value / reference parameters ).
+ *******************************************************************************/
+void GenDebug::init(llvm::Module &module, const char *filename, unsigned int pointerBits,
+                    bool linesOnly) {
+    std::string path = filename == nullptr ? "<stdin>" : filename;
+    std::string dir  = llvm::sys::path::parent_path(path).str();
+    if ( dir.empty() )
+        dir = ".";
+    module.addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                         llvm::DEBUG_METADATA_VERSION);
+    module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+    this->pointerBits = pointerBits;
+    this->linesOnly = linesOnly;
+    this->builder.reset(new llvm::DIBuilder(module));
+    this->file = this->builder->createFile(llvm::sys::path::filename(path), dir);
+    this->unit = this->builder->createCompileUnit(llvm::dwarf::DW_LANG_Pascal83,
+                                                  this->file, "Alan Compiler",
+                                                  false, "", 0, "",
+                                                  linesOnly ? llvm::DICompileUnit::LineTablesOnly
+                                                            : llvm::DICompileUnit::FullDebug);
+}
+
+bool GenDebug::enabled() const {
+    return this->builder != nullptr;
+}
+
+llvm::DIType* GenDebug::translate(sem::TypePtr type, sem::PassMode mode) {
+    if ( type->index >= this->types.size() )
+        this->types.resize(sem::typeCount(), nullptr);
+    llvm::DIType *ret = this->types[type->index];
+    if ( ret == nullptr && type->t != sem::genType::VOID ) {
+        ret = this->translateBase(type);
+        this->types[type->index] = ret;
+    }
+    if ( mode == sem::PassMode::REFERENCE )
+        ret = this->builder->createPointerType(ret, this->pointerBits);
+    return ret;
+}
+
+/*******************************************************************************
+ * Mirrors `translateType` : an iarray is a pointer to its elements,
+ * so with the reference mode on top it becomes a pointer.
+ *******************************************************************************/
+llvm::DIType* GenDebug::translateBase(sem::TypePtr type) {
+    switch ( type->t ) {
+        case sem::genType::INT :
+            return this->builder->createBasicType("int", 32, llvm::dwarf::DW_ATE_signed);
+        case sem::genType::BYTE :
+            return this->builder->createBasicType("byte", 8, llvm::dwarf::DW_ATE_unsigned_char);
+        case sem::genType::ARRAY : {
+            auto *elem = this->translate(type->getRef());
+            llvm::Metadata *range = this->builder->getOrCreateSubrange(0, type->getSize());
+            return this->builder->createArrayType(elem->getSizeInBits() * type->getSize(), 0,
+                                                  elem, this->builder->getOrCreateArray(range));
+        }
+        case sem::genType::IARRAY :
+            return this->translate(type->getRef());
+        default :
+            return nullptr;
+    }
+}
+
+void GenDebug::openFunc(llvm::Function *func, const std::string &name, int line,
+                        sem::TypePtr ret, const std::vector<sem::TypePtr> &params,
+                        const std::vector<sem::PassMode> &modes) {
+    if ( !this->enabled() )
+        return;
+    std::vector<llvm::Metadata*> signature;
+    if ( !this->linesOnly ) {
+        signature.push_back(this->translate(ret));
+        for ( std::size_t i = 0; i < params.size(); i++ )
+            signature.push_back(this->translate(params[i], modes[i]));
+    }
+    auto *ftype = this->builder->createSubroutineType(this->builder->getOrCreateTypeArray(signature));
+    llvm::DIScope *scope = this->funcs.empty() ? static_cast<llvm::DIScope*>(this->unit)
+                                               : this->funcs.back();
+    auto *sp = this->builder->createFunction(scope, name, func->getName(), this->file,
+                                             line, ftype, func->hasLocalLinkage(), true, line);
+    func->setSubprogram(sp);
+    this->funcs.push_back(sp);
+    this->lines.push_back(line);
+}
+
+/*******************************************************************************
+ * Nested functions are generated among the declarations of their parent,
+ * which goes on emitting code ( heap frames, the enter hook ) before its
+ * first statement, so the last location of the parent is restored.
+ *******************************************************************************/
+void GenDebug::closeFunc(llvm::IRBuilder<> &builder) {
+    if ( !this->enabled() )
+        return;
+    this->funcs.pop_back();
+    this->lines.pop_back();
+    if ( this->funcs.empty() )
+        builder.SetCurrentDebugLocation(llvm::DebugLoc());
+    else
+        this->setLocation(builder, this->lines.back());
+}
+
+void GenDebug::declareParam(llvm::AllocaInst *alloca, const std::string &name, unsigned int argNo,
+                            int line, sem::TypePtr type, sem::PassMode mode, llvm::BasicBlock *BB) {
+    if ( !this->enabled() || this->linesOnly )
+        return;
+    auto *sp  = this->funcs.back();
+    auto *var = this->builder->createParameterVariable(sp, name, argNo, this->file, line,
+                                                       this->translate(type, mode), true);
+    this->builder->insertDeclare(alloca, var, this->builder->createExpression(),
+                                 llvm::DILocation::get(sp->getContext(), line, 0, sp), BB);
+}
+
+void GenDebug::declareVar(llvm::AllocaInst *alloca, const std::string &name,
+                          int line, sem::TypePtr type, llvm::BasicBlock *BB) {
+    if ( !this->enabled() || this->linesOnly )
+        return;
+    auto *sp  = this->funcs.back();
+    auto *var = this->builder->createAutoVariable(sp, name, this->file, line,
+                                                  this->translate(type), true);
+    this->builder->insertDeclare(alloca, var, this->builder->createExpression(),
+                                 llvm::DILocation::get(sp->getContext(), line, 0, sp), BB);
+}
+
+/*******************************************************************************
+ * Big arrays of non recursive functions live in a global ( check
+ * codegenArray ), described as a static local of the function.
+ *******************************************************************************/
+void GenDebug::declareGlobal(llvm::GlobalVariable *global, const std::string &name,
+                             int line, sem::TypePtr type) {
+    if ( !this->enabled() || this->linesOnly )
+        return;
+    auto *gve = this->builder->createGlobalVariableExpression(this->funcs.back(), name,
+                                                              global->getName(), this->file,
+                                                              line, this->translate(type), true);
+    global->addDebugInfo(gve);
+}
+
+/*******************************************************************************
+ * Heap frames are only known through a pointer, so the pointer is kept in
+ * a stack slot and the variable is described as the memory it points to.
+ *******************************************************************************/
+void GenDebug::declareFrame(llvm::IRBuilder<> &builder, llvm::Value *frame, const std::string &name,
+                            int line, sem::TypePtr type) {
+    if ( !this->enabled() || this->linesOnly )
+        return;
+    auto *slot = builder.CreateAlloca(frame->getType(), nullptr, name + ".frame");
+    builder.CreateStore(frame, slot);
+    auto *sp   = this->funcs.back();
+    auto *var  = this->builder->createAutoVariable(sp, name, this->file, line,
+                                                   this->translate(type), true);
+    auto *expr = this->builder->createExpression(std::vector<uint64_t>{llvm::dwarf::DW_OP_deref});
+    this->builder->insertDeclare(slot, var, expr,
+                                 llvm::DILocation::get(sp->getContext(), line, 0, sp),
+                                 builder.GetInsertBlock());
+}
+
+void GenDebug::setLocation(llvm::IRBuilder<> &builder, int line) {
+    if ( !this->enabled() || this->funcs.empty() )
+        return;
+    auto *sp = this->funcs.back();
+    this->lines.back() = line;
+    builder.SetCurrentDebugLocation(llvm::DILocation::get(sp->getContext(), line, 0, sp));
+}
+
+void GenDebug::finalize() {
+    if ( this->enabled() )
+        this->builder->finalize();
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : debug.hpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Debug information header file (llvm stuff)                   *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __DEBUG_HPP__
+#define __DEBUG_HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+
+#include <symbol/types.hpp>
+#include <symbol/entry.hpp>
+
+/*******************************************************************************
+ * GenDebug Class ( only used with -g or -gline-tables-only )
+ *   - unit / file :
+ *     > The compile unit of the module and the source file.
+ *   - funcs :
+ *     > Subprograms of the functions being generated, innermost first.
+ *     > Nested functions are emitted while their parent is still open,
+ *     > so this behaves like genBlocks. A nested function is scoped by the
+ *     > subprogram of its parent.
+ *   - lines :
+ *     > The last line set in each of `funcs`, restored when a nested
+ *     > function is closed.
+ *   - types :
+ *     > Debug types, cached by the index of the ( interned ) semantic type,
+ *     > same as `translateType`.
+ *   - pointerBits :
+ *     > Pointer size of the target ( from the data layout ), the size of
+ *     > reference parameters and arrays passed by reference.
+ *   - linesOnly :
+ *     > Only functions and statement lines are described ( no types and
+ *     > variables ), which is what optimization remarks need to point at
+ *     > the Alan source.
+ * Every method does nothing when debug information is disabled, so codegen
+ * can call them unconditionally.
+ *******************************************************************************/
+class GenDebug {
+    private :
+        std::unique_ptr<llvm::DIBuilder> builder;
+        llvm::DICompileUnit             *unit;
+        llvm::DIFile                    *file;
+        std::vector<llvm::DISubprogram*> funcs;
+        std::vector<int>                 lines;
+        std::vector<llvm::DIType*>       types;
+        unsigned int                     pointerBits;
+        bool                             linesOnly;
+
+        llvm::DIType* translate(sem::TypePtr type, sem::PassMode mode = sem::PassMode::VALUE);
+        llvm::DIType* translateBase(sem::TypePtr type);
+    public :
+        GenDebug();
+        ~GenDebug();
+
+        void init(llvm::Module &module, const char *filename, unsigned int pointerBits,
+                  bool linesOnly);
+        bool enabled() const;
+
+        void openFunc(llvm::Function *func, const std::string &name, int line,
+                      sem::TypePtr ret, const std::vector<sem::TypePtr> &params,
+                      const std::vector<sem::PassMode> &modes);
+        void closeFunc(llvm::IRBuilder<> &builder);
+
+        void declareParam(llvm::AllocaInst *alloca, const std::string &name, unsigned int argNo,
+                          int line, sem::TypePtr type, sem::PassMode mode, llvm::BasicBlock *BB);
+        void declareVar(llvm::AllocaInst *alloca, const std::string &name,
+                        int line, sem::TypePtr type, llvm::BasicBlock *BB);
+        void declareGlobal(llvm::GlobalVariable *global, const std::string &name,
+                           int line, sem::TypePtr type);
+        void declareFrame(llvm::IRBuilder<> &builder, llvm::Value *frame, const std::string &name,
+                          int line, sem::TypePtr type);
+
+        void setLocation(llvm::IRBuilder<> &builder, int line);
+
+        void finalize();
+};
+
+#endif
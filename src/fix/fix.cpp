@@ -13,6 +13,8 @@
 #include <string.h>
 #include <string>
 
+#include <general/arena.hpp>
+
 static int findDigit(char c) {
     if ( c >= '0' && c <= '9' )
         return c - '0';
@@ -52,8 +54,12 @@ unsigned char fixChar(char * s, int& shift) {
     }
 }
 
+/*******************************************************************************
+ * String literals of the flex lexer : the unescaped copy belongs to the
+ * arena, like the ast that points to it.
+ *******************************************************************************/
 char * fixString(char * s) {
-    char * n = new char[strlen(s) + 1];
+    char * n = static_cast<char *>(arena.allocate(strlen(s) + 1, 1));
     int index = 0;
     int i = 0;
     int shift;
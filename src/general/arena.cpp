@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : arena.cpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Bump allocator for compilation lifetime objects              *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <general/arena.hpp>
+#include <message/message.hpp>
+
+thread_local Arena arena;
+
+Arena::Arena() {
+    this->chunks = nullptr;
+    this->cur    = nullptr;
+    this->end    = nullptr;
+    this->dtors  = nullptr;
+}
+
+Arena::~Arena() {
+    this->release();
+}
+
+/*******************************************************************************
+ * Chunks are linked through a small header at their start.
+ * Requests bigger than a chunk get a chunk of their own.
+ *******************************************************************************/
+void Arena::grow(std::size_t need) {
+    std::size_t size = sizeof(Chunk) + need;
+    if ( size < CHUNK_SIZE )
+        size = CHUNK_SIZE;
+    auto *chunk = static_cast<Chunk *>(std::malloc(size));
+    if ( chunk == nullptr )
+        internal("Out of memory");
+    chunk->next  = this->chunks;
+    chunk->size  = size;
+    this->chunks = chunk;
+    this->cur    = reinterpret_cast<char *>(chunk + 1);
+    this->end    = reinterpret_cast<char *>(chunk) + size;
+}
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+    auto p = reinterpret_cast<std::uintptr_t>(this->cur);
+    p = ( p + align - 1 ) & ~( align - 1 );
+    if ( this->cur == nullptr || p + size > reinterpret_cast<std::uintptr_t>(this->end) ) {
+        this->grow(size + align);
+        p = reinterpret_cast<std::uintptr_t>(this->cur);
+        p = ( p + align - 1 ) & ~( align - 1 );
+    }
+    this->cur = reinterpret_cast<char *>(p + size);
+    return reinterpret_cast<void *>(p);
+}
+
+/*******************************************************************************
+ * Runs the recorded destructors ( newest first ) and frees all chunks.
+ * The arena can be used again afterwards.
+ *******************************************************************************/
+void Arena::release() {
+    for ( Dtor *d = this->dtors; d != nullptr; d = d->next )
+        d->destroy(d->obj);
+    this->dtors = nullptr;
+    while ( this->chunks != nullptr ) {
+        Chunk *next = this->chunks->next;
+        std::free(this->chunks);
+        this->chunks = next;
+    }
+    this->cur = nullptr;
+    this->end = nullptr;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : arena.hpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Bump allocator for compilation lifetime objects              *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*******************************************************************************
+ * Arena :
+ *   - Owns every object that lives as long as the compilation
+ *     ( ast nodes, parser vectors, semantic types ).
+ *   - Memory is taken from big chunks by bumping a pointer, so an
+ *     allocation is a couple of instructions and there is no refcounting.
+ *   - Objects are never freed one by one. `release()` gives back all chunks
+ *     at once. Only objects that own memory themselves ( e.g. std::string,
+ *     std::vector members ) are recorded so that their destructors run.
+ *******************************************************************************/
+
+class Arena {
+    private :
+        struct Chunk {
+            Chunk       *next;
+            std::size_t  size;
+        };
+        struct Dtor {
+            Dtor  *next;
+            void (*destroy)(void *);
+            void  *obj;
+        };
+
+        static const std::size_t CHUNK_SIZE = 64 * 1024;
+
+        Chunk *chunks;
+        char  *cur;
+        char  *end;
+        Dtor  *dtors;
+
+        void grow(std::size_t need);
+
+        template<typename T>
+            static void destroy(void *obj) {
+                static_cast<T *>(obj)->~T();
+            }
+    public :
+        Arena();
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(std::size_t size, std::size_t align);
+        void release();
+
+        template<typename T, typename ... Args>
+            T* create(Args&& ... args) {
+                void *mem = this->allocate(sizeof(T), alignof(T));
+                T *obj = new (mem) T(std::forward<Args>(args)...);
+                if ( !std::is_trivially_destructible<T>::value ) {
+                    auto *d = static_cast<Dtor *>(this->allocate(sizeof(Dtor), alignof(Dtor)));
+                    d->next    = this->dtors;
+                    d->destroy = &Arena::destroy<T>;
+                    d->obj     = obj;
+                    this->dtors = d;
+                }
+                return obj;
+            }
+};
+
+/*******************************************************************************
+ * The arena of the current compilation ( one per thread, so threads
+ * compiling different programs never share it ).
+ *******************************************************************************/
+extern thread_local Arena arena;
+
+/*******************************************************************************
+ *   - newArena :
+ *     > Same as newShared, but the object is owned by the arena.
+ *******************************************************************************/
+
+template<typename T, typename ... Args>
+inline T* newArena(Args&& ... args) {
+    return arena.create<T>(std::forward<Args>(args)...);
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : intern.cpp                                                   *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Identifier interning                                         *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <general/intern.hpp>
+
+thread_local Interner symbols;
+
+SymbolId Interner::intern(std::string_view name) {
+    auto found = this->ids.find(name);
+    if ( found != this->ids.end() )
+        return found->second;
+    SymbolId id = this->names.size();
+    this->names.emplace_back(name);
+    this->ids.emplace(this->names.back(), id);
+    return id;
+}
+
+const std::string& Interner::name(SymbolId id) const {
+    return this->names[id];
+}
@@ -0,0 +1,53 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : intern.hpp                                                   *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Identifier interning                                         *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __INTERN_HPP__
+#define __INTERN_HPP__
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*******************************************************************************
+ * Interner :
+ *   - Every identifier is stored once and gets a small integer id.
+ *   > The lexer interns identifiers as soon as it finds them, so the rest of
+ *   > the compiler ( ast, symbol table, codegen ) compares and hashes ids
+ *   > instead of strings.
+ *   > Names are kept in a deque so that the views used as keys stay valid.
+ *   > Ids only mean something inside one compilation, so every thread has
+ *   > its own interner and interning needs no locking.
+ *******************************************************************************/
+
+typedef unsigned int SymbolId;
+
+class Interner {
+    private :
+        std::unordered_map<std::string_view, SymbolId> ids;
+        std::deque<std::string>                        names;
+    public :
+        SymbolId intern(std::string_view name);
+        const std::string& name(SymbolId id) const;
+};
+
+extern thread_local Interner symbols;
+
+inline SymbolId intern(std::string_view name) {
+    return symbols.intern(name);
+}
+
+inline const std::string& symbolName(SymbolId id) {
+    return symbols.name(id);
+}
+
+#endif
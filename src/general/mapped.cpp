@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : mapped.cpp                                                   *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Memory mapped input files                                    *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <general/arena.hpp>
+#include <general/mapped.hpp>
+
+struct MappedFile;
+
+/*******************************************************************************
+ * Mapping of the source file of the current compilation ( check mapSource ).
+ *******************************************************************************/
+static thread_local MappedFile  *sourceFile = nullptr;
+static thread_local std::string  sourcePath;
+
+/*******************************************************************************
+ * A mapped file, unmapped when the arena is released.
+ *******************************************************************************/
+struct MappedFile {
+    void        *map;
+    std::size_t  size;
+
+    MappedFile(void *map, std::size_t size) : map(map), size(size) {  }
+    ~MappedFile() {
+        munmap(this->map, this->size);
+        if ( sourceFile == this )
+            sourceFile = nullptr;
+    }
+};
+
+/*******************************************************************************
+ * Returns null for empty files ( `ok` tells them from failures ).
+ *******************************************************************************/
+static MappedFile* map(const char *path, bool writable, bool &ok) {
+    ok = false;
+    int fd = open(path, O_RDONLY);
+    if ( fd < 0 )
+        return nullptr;
+    struct stat st;
+    if ( fstat(fd, &st) < 0 ) {
+        close(fd);
+        return nullptr;
+    }
+    if ( st.st_size == 0 ) {
+        close(fd);
+        ok = true;
+        return nullptr;
+    }
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *data = mmap(nullptr, st.st_size, prot, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED )
+        return nullptr;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    ok = true;
+    return newArena<MappedFile>(data, st.st_size);
+}
+
+static void view(MappedFile *file, char *&data, std::size_t &size) {
+    data = file == nullptr ? nullptr : static_cast<char *>(file->map);
+    size = file == nullptr ? 0 : file->size;
+}
+
+bool mapFile(const char *path, bool writable, char *&data, std::size_t &size) {
+    bool ok;
+    view(map(path, writable, ok), data, size);
+    return ok;
+}
+
+bool mapSource(const char *path, char *&data, std::size_t &size) {
+    if ( sourceFile != nullptr && sourcePath == path ) {
+        view(sourceFile, data, size);
+        return true;
+    }
+    bool ok;
+    MappedFile *file = map(path, true, ok);
+    if ( file != nullptr ) {
+        sourceFile = file;
+        sourcePath = path;
+    }
+    view(file, data, size);
+    return ok;
+}
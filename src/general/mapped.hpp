@@ -0,0 +1,38 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : mapped.hpp                                                   *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Memory mapped input files                                    *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __MAPPED_HPP__
+#define __MAPPED_HPP__
+
+#include <cstddef>
+
+/*******************************************************************************
+ * Mapped files :
+ *   - Files are mapped privately, so a writable mapping can be changed in
+ *   > place ( the mmap lexer unescapes string literals this way ) without
+ *   > touching the file.
+ *   - The mapping belongs to the arena and is unmapped when it is released,
+ *   > so pointers into it ( e.g. string literals of the ast ) stay valid for
+ *   > the whole compilation.
+ *   - Returns false if the file cannot be opened or mapped. An empty file
+ *   > gives a null `data` and a zero `size`.
+ *******************************************************************************/
+
+bool mapFile(const char *path, bool writable, char *&data, std::size_t &size);
+
+/*******************************************************************************
+ * The source file is mapped ( writable ) once per compilation : the ast
+ * cache hashes the mapping and the mmap lexer then scans the same one.
+ *******************************************************************************/
+bool mapSource(const char *path, char *&data, std::size_t &size);
+
+#endif
@@ -0,0 +1,45 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : stack.cpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Dedicated stack for the compiler passes                      *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <pthread.h>
+
+#include <general/stack.hpp>
+#include <message/message.hpp>
+
+static void* run(void *body) {
+    ( *static_cast<void (**)()>(body) )();
+    return nullptr;
+}
+
+void runWithStack(std::size_t size, void (*body)()) {
+    if ( size == 0 ) {
+        body();
+        return;
+    }
+    pthread_attr_t attr;
+    pthread_t      thread;
+    pthread_attr_init(&attr);
+    if ( pthread_attr_setstacksize(&attr, size) != 0 )
+        fatal("Invalid stack size ", size);
+    /**
+     * Without a thread ( e.g. not enough address space )
+     * small programs still compile on the normal stack
+     */
+    if ( pthread_create(&thread, &attr, run, &body) != 0 ) {
+        warning("Cannot reserve a stack of ", size, " bytes, using the default one");
+        pthread_attr_destroy(&attr);
+        body();
+        return;
+    }
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+}
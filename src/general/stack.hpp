@@ -0,0 +1,30 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : stack.hpp                                                    *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Dedicated stack for the compiler passes                      *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __STACK_HPP__
+#define __STACK_HPP__
+
+#include <cstddef>
+
+/*******************************************************************************
+ * Compiler stack :
+ *   - semantic, fixCalls and codegen recurse once per nested expression,
+ *   > statement and block, so deeply nested ( usually machine-generated )
+ *   > programs would overflow the 8 MiB main thread stack.
+ *   - The whole compilation runs on a thread with a stack of `size` bytes
+ *   > instead. It is only reserved, pages are touched as the walks go deeper.
+ *   - A size of 0 runs `body` on the calling thread.
+ *******************************************************************************/
+
+void runWithStack(std::size_t size, void (*body)());
+
+#endif
@@ -0,0 +1,359 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : scanner.cpp                                                  *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Hand-written lexer working on a memory mapped source file    *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <string.h>
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <ast/ast.hpp>
+#include <parser/parser.hpp>
+#include <fix/fix.hpp>
+#include <general/arena.hpp>
+#include <general/intern.hpp>
+#include <general/mapped.hpp>
+#include <message/message.hpp>
+
+/*******************************************************************************
+ * Alternative to lexer.l ( enabled with -DALAN_MMAP_LEXER=ON ).
+ *   - The source file named on the command line is mapped privately and
+ *   > writable, so string literals are unescaped in place and handed to the
+ *   > parser as pointers into the mapping ( the closing quote becomes '\0' ).
+ *   > Identifiers are interned straight from the mapping.
+ *   - Whitespace and comment bodies are skipped 16 bytes at a time.
+ *   - Tokens are the same as the ones of lexer.l.
+ * If there is no file name, stdin is read into memory instead.
+ * The state of a scan is a Scanner ( ctx->scanner ), so it is reentrant.
+ * Literals point into the input, so the input belongs to the arena and
+ * lives as long as the ast.
+ *******************************************************************************/
+
+struct Scanner {
+    ParseContext *ctx;
+    char         *cur;
+    char         *end;
+};
+
+/*******************************************************************************
+ ********************************* Source Input ********************************
+ *******************************************************************************/
+
+static void readStdin(Scanner &s) {
+    std::string *buffer = newArena<std::string>();
+    char chunk[1 << 16];
+    size_t n;
+    while ( (n = fread(chunk, 1, sizeof(chunk), stdin)) > 0 )
+        buffer->append(chunk, n);
+    s.cur = &(*buffer)[0];
+    s.end = s.cur + buffer->size();
+}
+
+static void openSource(Scanner &s, const char *source) {
+    if ( source == nullptr ) {
+        readStdin(s);
+        return;
+    }
+    char *data;
+    std::size_t size;
+    if ( !mapSource(source, data, size) )
+        fatal("Cannot open source file");
+    if ( data == nullptr )
+        return;
+    s.cur = data;
+    s.end = data + size;
+}
+
+/*******************************************************************************
+ ********************************** Scanning ***********************************
+ *******************************************************************************/
+
+static inline bool isLetter(char c) {
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '_';
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isHex(char c) {
+    return isDigit(c) || ( c >= 'a' && c <= 'f' ) || ( c >= 'A' && c <= 'F' );
+}
+
+static inline bool isEscape(char c) {
+    return strchr("ntr0'\"\\", c) != nullptr && c != '\0';
+}
+
+/*******************************************************************************
+ * Skips ' ', '\t', '\r' and '\n', counting lines.
+ *******************************************************************************/
+static char* skipBlanks(char *p, char *end) {
+#if defined(__SSE2__)
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tb = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nl = _mm_set1_epi8('\n');
+    while ( end - p >= 16 ) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i n = _mm_cmpeq_epi8(c, nl);
+        __m128i w = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, sp), _mm_cmpeq_epi8(c, tb)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(c, cr), n));
+        unsigned int blanks = _mm_movemask_epi8(w);
+        unsigned int lines  = _mm_movemask_epi8(n);
+        if ( blanks == 0xFFFF ) {
+            linecount += __builtin_popcount(lines);
+            p += 16;
+            continue;
+        }
+        unsigned int stop = __builtin_ctz(~blanks);
+        linecount += __builtin_popcount(lines & ( (1u << stop) - 1 ));
+        return p + stop;
+    }
+#endif
+    for ( ; p < end; p++ ) {
+        if ( *p == '\n' )
+            ++linecount;
+        else if ( *p != ' ' && *p != '\t' && *p != '\r' )
+            break;
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Finds the next '(' or '*' inside a block comment, counting lines.
+ *******************************************************************************/
+static char* skipCommentText(char *p, char *end) {
+#if defined(__SSE2__)
+    const __m128i op = _mm_set1_epi8('(');
+    const __m128i st = _mm_set1_epi8('*');
+    const __m128i nl = _mm_set1_epi8('\n');
+    while ( end - p >= 16 ) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned int marks = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, op), _mm_cmpeq_epi8(c, st)));
+        unsigned int lines = _mm_movemask_epi8(_mm_cmpeq_epi8(c, nl));
+        if ( marks == 0 ) {
+            linecount += __builtin_popcount(lines);
+            p += 16;
+            continue;
+        }
+        unsigned int stop = __builtin_ctz(marks);
+        linecount += __builtin_popcount(lines & ( (1u << stop) - 1 ));
+        return p + stop;
+    }
+#endif
+    for ( ; p < end; p++ ) {
+        if ( *p == '\n' )
+            ++linecount;
+        else if ( *p == '(' || *p == '*' )
+            break;
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Skips a ( possibly nested ) block comment. `p` points after the first "(*".
+ *******************************************************************************/
+static char* skipComment(char *p, char *end) {
+    int nested = 0;
+    while ( true ) {
+        p = skipCommentText(p, end);
+        if ( p >= end )
+            return end;
+        if ( *p == '(' ) {
+            if ( p + 1 < end && p[1] == '*' ) {
+                ++nested;
+                p += 2;
+            } else {
+                p++;
+            }
+        } else {
+            if ( p + 1 < end && p[1] == ')' ) {
+                p += 2;
+                if ( nested == 0 )
+                    return p;
+                --nested;
+            } else {
+                p++;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+ * Skips a line comment. `p` points after "--".
+ *******************************************************************************/
+static char* skipLineComment(char *p, char *end) {
+    auto *nl = static_cast<char *>(memchr(p, '\n', end - p));
+    if ( nl == nullptr )
+        return end;
+    ++linecount;
+    return nl + 1;
+}
+
+static int keyword(std::string_view word) {
+    switch ( word.size() ) {
+        case 2 :
+            if ( word == "if" ) return T_if;
+            break;
+        case 3 :
+            if ( word == "int" ) return T_int;
+            break;
+        case 4 :
+            if ( word == "byte" ) return T_byte;
+            if ( word == "proc" ) return T_proc;
+            if ( word == "else" ) return T_else;
+            if ( word == "true" ) return T_true;
+            break;
+        case 5 :
+            if ( word == "while" ) return T_while;
+            if ( word == "false" ) return T_false;
+            break;
+        case 6 :
+            if ( word == "return" ) return T_ret;
+            break;
+        case 9 :
+            if ( word == "reference" ) return T_ref;
+            break;
+    }
+    return T_id;
+}
+
+/*******************************************************************************
+ * Character constant : a letter or an escape sequence between quotes.
+ *******************************************************************************/
+static int scanChar(Scanner &s, YYSTYPE *lval) {
+    char *p = s.cur;
+    char *end = s.end;
+    int shift = 0;
+    if ( end - p >= 3 && isLetter(p[1]) && p[2] == '\'' ) {
+        shift = 1;
+    } else if ( end - p >= 4 && p[1] == '\\' && isEscape(p[2]) && p[3] == '\'' ) {
+        shift = 2;
+    } else if ( end - p >= 6 && p[1] == '\\' && p[2] == 'x' && isHex(p[3]) && isHex(p[4]) && p[5] == '\'' ) {
+        shift = 4;
+    } else {
+        yyerror(s.ctx, "Illegal Character");
+    }
+    lval->c = fixChar(p + 1, shift);
+    s.cur = p + shift + 2;
+    return T_char;
+}
+
+/*******************************************************************************
+ * String literal : unescaped in place, the closing quote becomes '\0'.
+ *******************************************************************************/
+static int scanString(Scanner &s, YYSTYPE *lval) {
+    char *p = s.cur;
+    char *end = s.end;
+    char *q = p + 1;
+    int lines = 0;
+    while ( q < end && *q != '"' ) {
+        if ( *q == '\\' && q + 1 < end ) {
+            q += 2;
+            continue;
+        }
+        if ( *q == '\n' )
+            ++lines;
+        q++;
+    }
+    if ( q >= end )
+        yyerror(s.ctx, "Illegal Character");
+    char *dst = p + 1;
+    char *src = p + 1;
+    int shift;
+    while ( src < q ) {
+        *dst++ = fixChar(src, shift);
+        src += shift;
+    }
+    *dst = '\0';
+    linecount += lines;
+    lval->s = p + 1;
+    s.cur = q + 1;
+    return T_string;
+}
+
+int yylex(YYSTYPE *lval, ParseContext *ctx) {
+    Scanner &s = *static_cast<Scanner *>(ctx->scanner);
+    char *end = s.end;
+    while ( true ) {
+        s.cur = skipBlanks(s.cur, end);
+        if ( s.cur >= end )
+            return 0;
+        if ( s.cur[0] == '-' && s.cur + 1 < end && s.cur[1] == '-' ) {
+            s.cur = skipLineComment(s.cur + 2, end);
+            continue;
+        }
+        if ( s.cur[0] == '(' && s.cur + 1 < end && s.cur[1] == '*' ) {
+            s.cur = skipComment(s.cur + 2, end);
+            continue;
+        }
+        break;
+    }
+    char *p = s.cur;
+    char c = *p;
+    /* Names and keywords */
+    if ( isLetter(c) ) {
+        char *q = p + 1;
+        while ( q < end && ( isLetter(*q) || isDigit(*q) ) )
+            q++;
+        std::string_view word(p, q - p);
+        s.cur = q;
+        int token = keyword(word);
+        if ( token == T_id )
+            lval->id = intern(word);
+        return token;
+    }
+    /* Constants */
+    if ( isDigit(c) ) {
+        unsigned int n = 0;
+        char *q = p;
+        while ( q < end && isDigit(*q) )
+            n = n * 10 + ( *q++ - '0' );
+        lval->n = static_cast<int>(n);
+        s.cur = q;
+        return T_const;
+    }
+    if ( c == '\'' )
+        return scanChar(s, lval);
+    if ( c == '"' )
+        return scanString(s, lval);
+    /* Symbols */
+    if ( p + 1 < end && p[1] == '=' ) {
+        switch ( c ) {
+            case '=' : s.cur = p + 2; return T_eq;
+            case '!' : s.cur = p + 2; return T_neq;
+            case '<' : s.cur = p + 2; return T_le;
+            case '>' : s.cur = p + 2; return T_ge;
+        }
+    }
+    if ( strchr("()[]{}=+-*/%!&|<>,:;", c) != nullptr && c != '\0' ) {
+        s.cur = p + 1;
+        return c;
+    }
+    yyerror(ctx, "Illegal Character");
+    return 0;
+}
+
+void scanBegin(ParseContext *ctx, const char *source) {
+    auto *s = new Scanner{ ctx, nullptr, nullptr };
+    openSource(*s, source);
+    ctx->scanner = s;
+}
+
+void scanEnd(ParseContext *ctx) {
+    delete static_cast<Scanner *>(ctx->scanner);
+    ctx->scanner = nullptr;
+}
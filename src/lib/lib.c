@@ -124,3 +124,276 @@ void strcat(uint8_t *trg, uint8_t *src) {
     }
     return;
 }
+
+/*******************************************************************************
+ * Heap frames for big local arrays of recursive functions.
+ * Aligned to a cache line, freed before the function returns.
+ *******************************************************************************/
+
+void *__alan_alloc(int64_t size) {
+    void *p = NULL;
+    if ( posix_memalign(&p, 64, size) != 0 )
+        __alan_FATAL("cannot allocate array of %lld bytes", (long long) size);
+    return p;
+}
+
+void __alan_free(void *p) {
+    free(p);
+}
+
+/*******************************************************************************
+ * Function instrumentation ( compiled with --instrument-functions ) :
+ *   - Every Alan function calls `__alan_enter` on entry and `__alan_exit`
+ *   > before each return. The id is the function slot, the name is qualified
+ *   > by its parents ( e.g. main.hanoi.move ).
+ *   - Per function : calls, inclusive and exclusive cycles. Inclusive cycles
+ *   > of recursive functions are only counted for the outermost activation.
+ *   - Per call path : exclusive cycles, for flame graphs.
+ *   - Every call must be matched by a return. Functions whose counts differ
+ *   > ( missing exit hooks, or a program stopped by a runtime error ) are
+ *   > reported with a warning, since their cycles are incomplete.
+ *   - At exit the table is printed to stderr ( or to $ALAN_PROFILE ) and the
+ *   > folded stacks are written to $ALAN_PROFILE_FOLDED, if set.
+ *******************************************************************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t __alan_cycles() {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t __alan_cycles() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+typedef struct {
+    const char *name;
+    uint64_t    calls;
+    uint64_t    returns;
+    uint64_t    inclusive;
+    uint64_t    exclusive;
+    int32_t     active;
+} __alan_func_t;
+
+typedef struct {
+    int32_t  id;
+    int32_t  parent;
+    int32_t  child;
+    int32_t  sibling;
+    uint64_t exclusive;
+} __alan_path_t;
+
+typedef struct {
+    int32_t  path;
+    uint64_t start;
+    uint64_t children;
+} __alan_frame_t;
+
+static __alan_func_t  *__alan_funcs  = NULL;
+static int32_t         __alan_nfuncs = 0;
+static __alan_path_t  *__alan_paths  = NULL;
+static int32_t         __alan_npaths = 0;
+static int32_t         __alan_cpaths = 0;
+static __alan_frame_t *__alan_frames = NULL;
+static int32_t         __alan_depth  = 0;
+static int32_t         __alan_cdepth = 0;
+
+static void *__alan_grow(void *p, int32_t *cap, int32_t need, size_t size) {
+    if ( need <= *cap )
+        return p;
+    int32_t n = *cap == 0 ? 64 : *cap;
+    while ( n < need )
+        n *= 2;
+    p = realloc(p, n * size);
+    if ( p == NULL )
+        __alan_FATAL("out of memory in profiler");
+    for ( char *c = (char *) p + *cap * size; c < (char *) p + n * size; c++ )
+        *c = 0;
+    *cap = n;
+    return p;
+}
+
+static void __alan_folded(FILE *fp, int32_t path) {
+    if ( __alan_paths[path].parent > 0 ) {
+        __alan_folded(fp, __alan_paths[path].parent);
+        fputc(';', fp);
+    }
+    fputs(__alan_funcs[__alan_paths[path].id].name, fp);
+}
+
+static int __alan_by_exclusive(const void *a, const void *b) {
+    const __alan_func_t *x = *(const __alan_func_t * const *) a;
+    const __alan_func_t *y = *(const __alan_func_t * const *) b;
+    if ( x->exclusive != y->exclusive )
+        return x->exclusive < y->exclusive ? 1 : -1;
+    return 0;
+}
+
+static void __alan_report() {
+    int32_t n = 0;
+    __alan_func_t **sorted = malloc(( __alan_nfuncs + 1 ) * sizeof(*sorted));
+    for ( int32_t i = 0; i < __alan_nfuncs; i++ )
+        if ( __alan_funcs[i].calls > 0 )
+            sorted[n++] = &__alan_funcs[i];
+    qsort(sorted, n, sizeof(*sorted), __alan_by_exclusive);
+    const char *file = getenv("ALAN_PROFILE");
+    FILE *fp = file != NULL ? fopen(file, "w") : stderr;
+    if ( fp == NULL )
+        fp = stderr;
+    fprintf(fp, "%12s %20s %20s  %s\n", "calls", "inclusive", "exclusive", "function");
+    for ( int32_t i = 0; i < n; i++ )
+        fprintf(fp, "%12llu %20llu %20llu  %s\n",
+                (unsigned long long) sorted[i]->calls,
+                (unsigned long long) sorted[i]->inclusive,
+                (unsigned long long) sorted[i]->exclusive,
+                sorted[i]->name);
+    for ( int32_t i = 0; i < n; i++ )
+        if ( sorted[i]->returns != sorted[i]->calls )
+            fprintf(fp, "warning: %s returned %llu times out of %llu calls\n",
+                    sorted[i]->name,
+                    (unsigned long long) sorted[i]->returns,
+                    (unsigned long long) sorted[i]->calls);
+    if ( fp != stderr )
+        fclose(fp);
+    free(sorted);
+    file = getenv("ALAN_PROFILE_FOLDED");
+    if ( file == NULL || ( fp = fopen(file, "w") ) == NULL )
+        return;
+    for ( int32_t i = 1; i < __alan_npaths; i++ ) {
+        if ( __alan_paths[i].exclusive == 0 )
+            continue;
+        __alan_folded(fp, i);
+        fprintf(fp, " %llu\n", (unsigned long long) __alan_paths[i].exclusive);
+    }
+    fclose(fp);
+}
+
+void __alan_enter(int32_t id, const char *name) {
+    uint64_t now = __alan_cycles();
+    if ( __alan_npaths == 0 ) {
+        /* Path 0 is the root of all call paths */
+        __alan_paths = __alan_grow(__alan_paths, &__alan_cpaths, 1, sizeof(__alan_path_t));
+        __alan_npaths = 1;
+        atexit(__alan_report);
+    }
+    if ( id >= __alan_nfuncs ) {
+        __alan_funcs = __alan_grow(__alan_funcs, &__alan_nfuncs, id + 1, sizeof(__alan_func_t));
+    }
+    __alan_func_t *f = &__alan_funcs[id];
+    f->name = name;
+    f->calls++;
+    f->active++;
+    /* Find ( or add ) the path of this call under the current one */
+    int32_t parent = __alan_depth > 0 ? __alan_frames[__alan_depth - 1].path : 0;
+    int32_t path = __alan_paths[parent].child;
+    while ( path != 0 && __alan_paths[path].id != id )
+        path = __alan_paths[path].sibling;
+    if ( path == 0 ) {
+        __alan_paths = __alan_grow(__alan_paths, &__alan_cpaths, __alan_npaths + 1, sizeof(__alan_path_t));
+        path = __alan_npaths++;
+        __alan_paths[path].id      = id;
+        __alan_paths[path].parent  = parent;
+        __alan_paths[path].sibling = __alan_paths[parent].child;
+        __alan_paths[parent].child = path;
+    }
+    __alan_frames = __alan_grow(__alan_frames, &__alan_cdepth, __alan_depth + 1, sizeof(__alan_frame_t));
+    __alan_frame_t *frame = &__alan_frames[__alan_depth++];
+    frame->path     = path;
+    frame->children = 0;
+    frame->start    = __alan_cycles();
+    /* Do not charge the bookkeeping to the caller */
+    if ( __alan_depth > 1 )
+        __alan_frames[__alan_depth - 2].children += frame->start - now;
+}
+
+void __alan_exit() {
+    uint64_t now = __alan_cycles();
+    if ( __alan_depth == 0 )
+        return;
+    __alan_frame_t *frame = &__alan_frames[--__alan_depth];
+    __alan_path_t  *path  = &__alan_paths[frame->path];
+    __alan_func_t  *f     = &__alan_funcs[path->id];
+    uint64_t elapsed   = now - frame->start;
+    uint64_t exclusive = elapsed - frame->children;
+    f->returns++;
+    f->exclusive    += exclusive;
+    path->exclusive += exclusive;
+    if ( --f->active == 0 )
+        f->inclusive += elapsed;
+    if ( __alan_depth > 0 )
+        __alan_frames[__alan_depth - 1].children += elapsed + ( __alan_cycles() - now );
+}
+
+/*******************************************************************************
+ * Statement coverage ( compiled with --coverage ) :
+ *   - main registers the counters of the program and the line of each one.
+ *   - At exit the counts per line are added to $ALAN_COVERAGE
+ *   > ( default : <source>.cov ), so several runs accumulate.
+ *   - File format : `source <path>` followed by `<line> <count>` lines.
+ *   > A line with many counters reports the biggest one.
+ *******************************************************************************/
+
+static const char     *__alan_cov_source = NULL;
+static int32_t         __alan_cov_n      = 0;
+static const int32_t  *__alan_cov_lines  = NULL;
+static const uint64_t *__alan_cov_counts = NULL;
+
+static void __alan_coverage_write() {
+    int32_t maxline = 0;
+    for ( int32_t i = 0; i < __alan_cov_n; i++ )
+        if ( __alan_cov_lines[i] > maxline )
+            maxline = __alan_cov_lines[i];
+    /* -1 marks lines without counters */
+    int64_t *counts = malloc(( maxline + 1 ) * sizeof(int64_t));
+    if ( counts == NULL )
+        __alan_FATAL("out of memory in coverage");
+    for ( int32_t l = 0; l <= maxline; l++ )
+        counts[l] = -1;
+    for ( int32_t i = 0; i < __alan_cov_n; i++ ) {
+        int32_t l = __alan_cov_lines[i];
+        if ( (int64_t) __alan_cov_counts[i] > counts[l] )
+            counts[l] = __alan_cov_counts[i];
+    }
+    char path[4096];
+    const char *file = getenv("ALAN_COVERAGE");
+    if ( file == NULL ) {
+        snprintf(path, sizeof(path), "%s.cov", __alan_cov_source);
+        file = path;
+    }
+    /* Add the counts of previous runs */
+    FILE *fp = fopen(file, "r");
+    if ( fp != NULL ) {
+        int32_t l;
+        long long c;
+        char header[4096];
+        if ( fgets(header, sizeof(header), fp) != NULL )
+            while ( fscanf(fp, "%d %lld", &l, &c) == 2 )
+                if ( l >= 0 && l <= maxline && counts[l] >= 0 )
+                    counts[l] += c;
+        fclose(fp);
+    }
+    fp = fopen(file, "w");
+    if ( fp == NULL ) {
+        fprintf(stderr, "Alan runtime error: cannot write coverage to %s\n", file);
+        free(counts);
+        return;
+    }
+    fprintf(fp, "source %s\n", __alan_cov_source);
+    for ( int32_t l = 0; l <= maxline; l++ )
+        if ( counts[l] >= 0 )
+            fprintf(fp, "%d %lld\n", l, (long long) counts[l]);
+    fclose(fp);
+    free(counts);
+}
+
+void __alan_coverage(const char *source, int32_t n, const int32_t *lines, const uint64_t *counts) {
+    __alan_cov_source = source;
+    __alan_cov_n      = n;
+    __alan_cov_lines  = lines;
+    __alan_cov_counts = counts;
+    atexit(__alan_coverage_write);
+}
@@ -12,16 +12,5 @@
 
 #include <message/message.hpp>
 
-#include <iostream>
-#include <deque>
-
-
-void Debugger::newLevel() {
-    this->prefixes.push_front(this->prefix);
-    this->prefix.append("| ");
-}
-
-void Debugger::restoreLevel() {
-    this->prefix = this->prefixes.front();
-    this->prefixes.pop_front();
-}
+thread_local int          linecount = 1;
+thread_local const char * filename  = nullptr;
@@ -15,12 +15,16 @@
 
 #include <iostream>
 #include <string>
-#include <deque>
 
-typedef std::deque<std::string> stringStack;
-
-extern int    linecount;
-extern char * filename;
+/*******************************************************************************
+ * Location of diagnostics :
+ *   - Every thread compiles ( at most ) one program at a time, so the file
+ *   > and the current line are per thread. The lexer moves `linecount`
+ *   > while parsing, the later passes set it to the line of the node they
+ *   > are working on.
+ *******************************************************************************/
+extern thread_local int          linecount;
+extern thread_local const char * filename;
 
 /*******************************************************************************
  * Variadic template functions must be declared and implemented in header
@@ -75,26 +79,4 @@ void debug(Args&& ... args) {
 #endif
 }
 
-/*******************************************************************************
- * Debugger class
- *   > Helps with printing the ast.
- *   > It does this while performing semantic analysis.
- *   > It prints types too ( so cool ).
- *******************************************************************************/
-class Debugger {
-    private :
-        std::string prefix = "| ";
-        stringStack prefixes;
-    public :
-        void newLevel();
-        void restoreLevel();
-        template<typename ... Args>
-            void show(Args&& ... args){
-#ifndef NDEBUG
-                std::cerr << this->prefix;
-                display(args...);
-#endif
-            }
-};
-
 #endif
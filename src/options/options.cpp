@@ -0,0 +1,135 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : options.cpp                                                  *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Command line options                                         *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <options/options.hpp>
+
+Options options;
+
+Options::Options() {
+    this->debugInfo           = false;
+    this->lineTables          = false;
+    this->instrumentFunctions = false;
+    this->coverage            = false;
+    this->stackArrayLimit     = 64 * 1024;
+    this->wrapv               = false;
+    this->nativeArch          = false;
+    this->module              = false;
+    this->stackSize           = 1ull << 30;
+    this->evalSteps           = 1000000;
+    this->evalDepth           = 512;
+    this->dumpAst             = DumpFormat::NONE;
+}
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [OPTIONS] FILENAME" << std::endl
+              << "  -g                        emit debug information" << std::endl
+              << "  -gline-tables-only        emit statement lines only" << std::endl
+              << "  --instrument-functions    profile function calls" << std::endl
+              << "  --coverage                count statement executions" << std::endl
+              << "  --stack-array-limit=BYTES biggest array kept on the stack" << std::endl
+              << "  --wrapv                   int overflow wraps around" << std::endl
+              << "  --target=TRIPLE           target triple" << std::endl
+              << "  -march=native             use all features of the host" << std::endl
+              << "  -mcpu=CPU                 target cpu" << std::endl
+              << "  --module                  export the top-level function" << std::endl
+              << "  --interface=FILE          write the module interface" << std::endl
+              << "  --import=FILE             use a module interface" << std::endl
+              << "  --stack-size=BYTES        stack of the compiler passes" << std::endl
+              << "  --ast-cache=FILE          cache of the checked ast" << std::endl
+              << "  --eval-steps=N            compile-time evaluation budget" << std::endl
+              << "  --eval-depth=N            compile-time evaluation call depth" << std::endl
+              << "  --dump-ast[=json|text]    print the checked ast and stop" << std::endl;
+    exit(-1);
+}
+
+/*******************************************************************************
+ * Returns the value of `--name=value` options, or null for other options.
+ *******************************************************************************/
+static const char* value(const char *arg, const char *name) {
+    std::size_t n = strlen(name);
+    if ( strncmp(arg, name, n) != 0 || arg[n] != '=' )
+        return nullptr;
+    return arg + n + 1;
+}
+
+const char* parseOptions(int argc, char *argv[]) {
+    const char *input = nullptr;
+    for ( int i = 1; i < argc; i++ ) {
+        const char *arg = argv[i];
+        if ( arg[0] != '-' ) {
+            if ( input != nullptr )
+                usage(argv[0]);
+            input = arg;
+        } else if ( strcmp(arg, "-g") == 0 ) {
+            options.debugInfo = true;
+        } else if ( strcmp(arg, "-gline-tables-only") == 0 ) {
+            options.lineTables = true;
+        } else if ( strcmp(arg, "--instrument-functions") == 0 ) {
+            options.instrumentFunctions = true;
+        } else if ( strcmp(arg, "--coverage") == 0 ) {
+            options.coverage = true;
+        } else if ( strcmp(arg, "--wrapv") == 0 ) {
+            options.wrapv = true;
+        } else if ( const char *v = value(arg, "--stack-array-limit") ) {
+            options.stackArrayLimit = strtoull(v, nullptr, 10);
+        } else if ( const char *v = value(arg, "--target") ) {
+            options.target = v;
+        } else if ( const char *v = value(arg, "-march") ) {
+            if ( strcmp(v, "native") != 0 ) {
+                std::cerr << "Only -march=native is supported, use -mcpu" << std::endl;
+                usage(argv[0]);
+            }
+            options.nativeArch = true;
+        } else if ( const char *v = value(arg, "-mcpu") ) {
+            options.cpu = v;
+        } else if ( strcmp(arg, "--module") == 0 ) {
+            options.module = true;
+        } else if ( const char *v = value(arg, "--interface") ) {
+            options.interface = v;
+        } else if ( const char *v = value(arg, "--import") ) {
+            options.imports.push_back(v);
+        } else if ( const char *v = value(arg, "--stack-size") ) {
+            options.stackSize = strtoull(v, nullptr, 10);
+        } else if ( const char *v = value(arg, "--ast-cache") ) {
+            options.astCache = v;
+        } else if ( const char *v = value(arg, "--eval-steps") ) {
+            options.evalSteps = strtoull(v, nullptr, 10);
+        } else if ( const char *v = value(arg, "--eval-depth") ) {
+            options.evalDepth = strtoull(v, nullptr, 10);
+        } else if ( strcmp(arg, "--dump-ast") == 0 ) {
+            options.dumpAst = DumpFormat::TEXT;
+        } else if ( const char *v = value(arg, "--dump-ast") ) {
+            if ( strcmp(v, "text") == 0 )
+                options.dumpAst = DumpFormat::TEXT;
+            else if ( strcmp(v, "json") == 0 )
+                options.dumpAst = DumpFormat::JSON;
+            else
+                usage(argv[0]);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            usage(argv[0]);
+        }
+    }
+    /**
+     * Counters and profiling ids are numbered per file,
+     * so they are only registered by a whole program
+     */
+    if ( options.module && ( options.coverage || options.instrumentFunctions ) ) {
+        std::cerr << "--coverage and --instrument-functions need a whole program" << std::endl;
+        usage(argv[0]);
+    }
+    return input;
+}
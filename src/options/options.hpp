@@ -0,0 +1,88 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : options.hpp                                                  *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Command line options                                         *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __OPTIONS_HPP__
+#define __OPTIONS_HPP__
+
+#include <string>
+#include <vector>
+
+enum class DumpFormat {
+    NONE,
+    TEXT,
+    JSON
+};
+
+/*******************************************************************************
+ * Options :
+ *   - Filled once by `parseOptions` before parsing starts and only read
+ *   > afterwards.
+ *   - Usage : ALAN [OPTIONS] FILENAME
+ *     > -g                     : emit DWARF debug information
+ *     > -gline-tables-only     : only emit the line of every statement, enough
+ *     >                          for optimization remarks and profilers
+ *     > --instrument-functions : call the profiling hooks of the runtime on
+ *     >                          every function entry and exit
+ *     > --coverage             : count how many times every statement runs
+ *     > --stack-array-limit=N  : arrays bigger than N bytes are not put on
+ *     >                          the stack ( check VarDecl::codegen )
+ *     > --wrapv                : int overflow wraps instead of being undefined
+ *     > --target=TRIPLE        : target triple ( default : the host )
+ *     > -march=native          : use every feature of the host cpu
+ *     > -mcpu=CPU              : tune for and use the features of CPU
+ *     > --module               : export the top-level function instead of
+ *     >                          making it the program entry
+ *     > --interface=FILE       : write the interface of the top-level
+ *     >                          function to FILE ( check symbol/interface )
+ *     > --import=FILE          : call the functions of an interface file
+ *     >                          ( can be repeated )
+ *     > --stack-size=BYTES     : stack of the compiler itself, bounds how deep
+ *     >                          programs can nest ( check general/stack )
+ *     > --ast-cache=FILE       : reuse the checked ast stored in FILE if the
+ *     >                          source is unchanged ( check ast/cache.cpp )
+ *     > --eval-steps=N         : budget of the compile-time evaluation of
+ *     >                          a call, 0 disables it ( check ast/eval.cpp )
+ *     > --eval-depth=N         : nested calls allowed while evaluating
+ *     > --dump-ast[=json|text] : print the checked ast instead of compiling
+ *     >                          ( check ast/dump.cpp )
+ *******************************************************************************/
+
+struct Options {
+    bool debugInfo;
+    bool lineTables;
+    bool instrumentFunctions;
+    bool coverage;
+    unsigned long long stackArrayLimit;
+    bool wrapv;
+    std::string target;
+    std::string cpu;
+    bool nativeArch;
+    bool module;
+    std::string interface;
+    std::vector<std::string> imports;
+    unsigned long long stackSize;
+    std::string astCache;
+    unsigned long long evalSteps;
+    unsigned long long evalDepth;
+    DumpFormat dumpAst;
+
+    Options();
+};
+
+extern Options options;
+
+/*******************************************************************************
+ * Returns the input file name, or null if there is none ( read stdin ).
+ *******************************************************************************/
+const char* parseOptions(int argc, char *argv[]);
+
+#endif
@@ -8,25 +8,68 @@
 #include <symbol/types.hpp>
 #include <ast/ast.hpp>
 #include <general/general.hpp>
+#include <general/arena.hpp>
+#include <general/intern.hpp>
+#include <message/message.hpp>
 
-void yyerror (const char *msg);
-extern int yylex();
+using ast::newNode;
 
-ast::astPtr * t;
-extern int    linecount;
-
-std::vector<ast::astPtr*>  nodes;
-std::vector<ast::astVec*>  vecs;
-std::vector<sem::TypePtr*> types;
+/**
+ * Nested parentheses and blocks grow the parser stack ( on the heap ),
+ * do not give up after the default 10000 levels
+ */
+#define YYMAXDEPTH 100000000
 
 %}
 
+/*******************************************************************************
+ * The parser is pure : everything a parse needs lives in its ParseContext
+ * ( and in the thread local arena / interner ), so several threads can
+ * parse different programs at the same time.
+ *******************************************************************************/
+%define api.pure full
+%parse-param { ParseContext *ctx }
+%lex-param   { ParseContext *ctx }
+
+%code requires {
+#include <ast/ast.hpp>
+
+/*******************************************************************************
+ * State of one parse :
+ *   - root    : the program, once parsing is over
+ *   - scanner : state of the lexer ( flex or mmap one ), owned by it
+ *******************************************************************************/
+struct ParseContext {
+    ast::astPtr  root    = nullptr;
+    void        *scanner = nullptr;
+};
+}
+
+%code provides {
+/*******************************************************************************
+ * Implemented by the lexer :
+ *   - scanBegin : opens `source` ( stdin if null ) and sets up ctx->scanner
+ *   - scanEnd   : releases what scanBegin set up
+ *******************************************************************************/
+int  yylex(YYSTYPE *lval, ParseContext *ctx);
+void scanBegin(ParseContext *ctx, const char *source);
+void scanEnd(ParseContext *ctx);
+
+void yyerror(ParseContext *ctx, const char *msg);
+
+/*******************************************************************************
+ * Parses a whole program, returns null on syntax errors.
+ *******************************************************************************/
+ast::astPtr parse(const char *source);
+}
+
 %union {
-    ast::astPtr   * a;
+    ast::NodeRef    a;
     int             n;
     unsigned char   c;
     char          * s;
-    sem::TypePtr  * t;
+    SymbolId        id;
+    sem::Type     * t;
     ast::astVec   * v;
 }
 
@@ -45,7 +88,7 @@ std::vector<sem::TypePtr*> types;
 %token T_le    "<="
 %token T_ge    ">="
 
-%token<s> T_id
+%token<id> T_id
 %token<n> T_const
 %token<c> T_char
 %token<s> T_string
@@ -89,89 +132,89 @@ std::vector<sem::TypePtr*> types;
 %%
 
 data_type
-    : "int"  { $$ = &sem::typeInteger; }
-    | "byte" { $$ = &sem::typeByte;    }
+    : "int"  { $$ = sem::typeInteger; }
+    | "byte" { $$ = sem::typeByte;    }
     ;
 
 type
-    : data_type '[' ']' { $$ = new sem::TypePtr(newShared<sem::TypeIArray>(*$1)); types.push_back($$); }
-    | data_type         { $$ = $1;                                                                     }
+    : data_type '[' ']' { $$ = sem::typeIArray($1); }
+    | data_type         { $$ = $1;                  }
     ;
 
 r_type
-    : data_type { $$ = $1;             }
-    | "proc"    { $$ = &sem::typeVoid; }
+    : data_type { $$ = $1;            }
+    | "proc"    { $$ = sem::typeVoid; }
     ;
 
 cond
-    : "true"         { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::TRU, nullptr, nullptr)); nodes.push_back($$);  }
-    | "false"        { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::FALS, nullptr, nullptr)); nodes.push_back($$); }
-    | '(' cond ')'   { $$ = $2;                                                                                                 }
-    | '!' cond       { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::NOT, nullptr, *$2)); nodes.push_back($$);      }
-    | expr '<' expr  { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::LT, *$1, *$3)); nodes.push_back($$);           }
-    | expr '>' expr  { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::GT, *$1, *$3)); nodes.push_back($$);           }
-    | expr "==" expr { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::EQ, *$1, *$3)); nodes.push_back($$);           }
-    | expr "!=" expr { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::NEQ, *$1, *$3)); nodes.push_back($$);          }
-    | expr "<=" expr { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::LE, *$1, *$3)); nodes.push_back($$);           }
-    | expr ">=" expr { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::GE, *$1, *$3)); nodes.push_back($$);           }
-    | cond '&' cond  { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::AND, *$1, *$3)); nodes.push_back($$);          }
-    | cond '|' cond  { $$ = new ast::astPtr(newShared<ast::Condition>(ast::Cond::OR, *$1, *$3)); nodes.push_back($$);           }
+    : "true"         { $$ = newNode<ast::Condition>(ast::Cond::TRU, nullptr, nullptr);  }
+    | "false"        { $$ = newNode<ast::Condition>(ast::Cond::FALS, nullptr, nullptr); }
+    | '(' cond ')'   { $$ = $2;                                                         }
+    | '!' cond       { $$ = newNode<ast::Condition>(ast::Cond::NOT, nullptr, $2);       }
+    | expr '<' expr  { $$ = newNode<ast::Condition>(ast::Cond::LT, $1, $3);             }
+    | expr '>' expr  { $$ = newNode<ast::Condition>(ast::Cond::GT, $1, $3);             }
+    | expr "==" expr { $$ = newNode<ast::Condition>(ast::Cond::EQ, $1, $3);             }
+    | expr "!=" expr { $$ = newNode<ast::Condition>(ast::Cond::NEQ, $1, $3);            }
+    | expr "<=" expr { $$ = newNode<ast::Condition>(ast::Cond::LE, $1, $3);             }
+    | expr ">=" expr { $$ = newNode<ast::Condition>(ast::Cond::GE, $1, $3);             }
+    | cond '&' cond  { $$ = newNode<ast::Condition>(ast::Cond::AND, $1, $3);            }
+    | cond '|' cond  { $$ = newNode<ast::Condition>(ast::Cond::OR, $1, $3);             }
     ;
 
 l_value
-    : T_id '[' expr ']' { $$ = new ast::astPtr(newShared<ast::Var>(std::string($1), *$3)); nodes.push_back($$);     }
-    | T_string          { $$ = new ast::astPtr(newShared<ast::String>(std::string($1))); nodes.push_back($$);       }
-    | T_id              { $$ = new ast::astPtr(newShared<ast::Var>(std::string($1), nullptr)); nodes.push_back($$); }
+    : T_id '[' expr ']' { $$ = newNode<ast::Var>($1, $3);      }
+    | T_string          { $$ = newNode<ast::String>($1);       }
+    | T_id              { $$ = newNode<ast::Var>($1, nullptr); }
     ;
 
 expr
-    : T_const               { $$ = new ast::astPtr(newShared<ast::Int>($1)); nodes.push_back($$);                                 }
-    | T_char                { $$ = new ast::astPtr(newShared<ast::Byte>($1)); nodes.push_back($$);                                }
-    | l_value               { $$ = $1;                                                                                            }
-    | '(' expr ')'          { $$ = $2;                                                                                            }
-    | func_call             { $$ = $1;                                                                                            }
-    | expr '+' expr         { $$ = new ast::astPtr(newShared<ast::BinOp>('+', *$1, *$3)); nodes.push_back($$);                    }
-    | expr '-' expr         { $$ = new ast::astPtr(newShared<ast::BinOp>('-', *$1, *$3)); nodes.push_back($$);                    }
-    | expr '*' expr         { $$ = new ast::astPtr(newShared<ast::BinOp>('*', *$1, *$3)); nodes.push_back($$);                    }
-    | expr '/' expr         { $$ = new ast::astPtr(newShared<ast::BinOp>('/', *$1, *$3)); nodes.push_back($$);                    }
-    | expr '%' expr         { $$ = new ast::astPtr(newShared<ast::BinOp>('%', *$1, *$3)); nodes.push_back($$);                    }
-    | '+' expr %prec UPLUS  { $$ = new ast::astPtr(newShared<ast::BinOp>('+', newShared<ast::Int>(0), *$2)); nodes.push_back($$); }
-    | '-' expr %prec UMINUS { $$ = new ast::astPtr(newShared<ast::BinOp>('-', newShared<ast::Int>(0), *$2)); nodes.push_back($$); }
+    : T_const               { $$ = newNode<ast::Int>($1);                              }
+    | T_char                { $$ = newNode<ast::Byte>($1);                             }
+    | l_value               { $$ = $1;                                                 }
+    | '(' expr ')'          { $$ = $2;                                                 }
+    | func_call             { $$ = $1;                                                 }
+    | expr '+' expr         { $$ = newNode<ast::BinOp>('+', $1, $3);                   }
+    | expr '-' expr         { $$ = newNode<ast::BinOp>('-', $1, $3);                   }
+    | expr '*' expr         { $$ = newNode<ast::BinOp>('*', $1, $3);                   }
+    | expr '/' expr         { $$ = newNode<ast::BinOp>('/', $1, $3);                   }
+    | expr '%' expr         { $$ = newNode<ast::BinOp>('%', $1, $3);                   }
+    | '+' expr %prec UPLUS  { $$ = newNode<ast::BinOp>('+', newNode<ast::Int>(0), $2); }
+    | '-' expr %prec UMINUS { $$ = newNode<ast::BinOp>('-', newNode<ast::Int>(0), $2); }
     ;
 
 expr_list
-    : /* nothing */      { $$ = new ast::astVec(); vecs.push_back($$);                     }
-    | expr_list ',' expr { $$ = $1; $$->push_back(*$3);                                    }
-    | expr               { $$ = new ast::astVec(); $$->push_back(*$1); vecs.push_back($$); }
+    : /* nothing */      { $$ = newArena<ast::astVec>();                    }
+    | expr_list ',' expr { $$ = $1; $$->push_back($3);                      }
+    | expr               { $$ = newArena<ast::astVec>(); $$->push_back($1); }
     ;
 
 func_call
-    : T_id '(' expr_list ')' { $$ = new ast::astPtr(newShared<ast::Call>(std::string($1), *$3)); nodes.push_back($$); }
+    : T_id '(' expr_list ')' { $$ = newNode<ast::Call>($1, std::move(*$3)); }
     ;
 
 stmt
-    : ';'                                 { $$ = nullptr;                                                                         }
-    | l_value '=' expr ';'                { $$ = new ast::astPtr(newShared<ast::Assign>(*$1, *$3)); nodes.push_back($$);          }
-    | compound_stmt                       { $$ = $1;                                                                              }
-    | func_call ';'                       { $$ = $1;                                                                              }
-    | "if" '(' cond ')' stmt %prec NOELSE { $$ = new ast::astPtr(newShared<ast::IfElse>(*$3, *$5, nullptr)); nodes.push_back($$); }
-    | "if" '(' cond ')' stmt "else" stmt  { $$ = new ast::astPtr(newShared<ast::IfElse>(*$3, *$5, *$7)); nodes.push_back($$);     }
-    | "while" '(' cond ')' stmt           { $$ = new ast::astPtr(newShared<ast::While>(*$3, *$5)); nodes.push_back($$);           }
-    | "return" expr ';'                   { $$ = new ast::astPtr(newShared<ast::Ret>(*$2)); nodes.push_back($$);                  }
+    : ';'                                 { $$ = nullptr;                               }
+    | l_value '=' expr ';'                { $$ = newNode<ast::Assign>($1, $3);          }
+    | compound_stmt                       { $$ = $1;                                    }
+    | func_call ';'                       { $$ = $1;                                    }
+    | "if" '(' cond ')' stmt %prec NOELSE { $$ = newNode<ast::IfElse>($3, $5, nullptr); }
+    | "if" '(' cond ')' stmt "else" stmt  { $$ = newNode<ast::IfElse>($3, $5, $7);      }
+    | "while" '(' cond ')' stmt           { $$ = newNode<ast::While>($3, $5);           }
+    | "return" expr ';'                   { $$ = newNode<ast::Ret>($2);                 }
     ;
 
 stmt_list
-    : /* nothing */  { $$ = new ast::astVec(); vecs.push_back($$); }
-    | stmt_list stmt { $$ = $1; $$->push_back(*$2);                }
+    : /* nothing */  { $$ = newArena<ast::astVec>();                    }
+    | stmt_list stmt { $$ = $1; if ( $2 != nullptr ) $$->push_back($2); }
     ;
 
 compound_stmt
-    : '{' stmt_list '}' { $$ = new ast::astPtr(newShared<ast::Block>(*$2)); nodes.push_back($$); }
+    : '{' stmt_list '}' { $$ = newNode<ast::Block>(std::move(*$2)); }
     ;
 
 var_def
-    : T_id ':' data_type '[' T_const ']' ';' { $$ = new ast::astPtr(newShared<ast::VarDecl>(std::string($1), std::make_shared<sem::TypeArray>($5, *$3))); nodes.push_back($$); }
-    | T_id ':' data_type ';'                 { $$ = new ast::astPtr(newShared<ast::VarDecl>(std::string($1), *$3)); nodes.push_back($$);                                       }
+    : T_id ':' data_type '[' T_const ']' ';' { $$ = newNode<ast::VarDecl>($1, sem::typeArray($5, $3)); }
+    | T_id ':' data_type ';'                 { $$ = newNode<ast::VarDecl>($1, $3);                     }
     ;
 
 local_def
@@ -180,51 +223,47 @@ local_def
     ;
 
 local_def_list
-    : /* nothing */            { $$ = new ast::astVec(); vecs.push_back($$); }
-    | local_def_list local_def { $$ = $1; $$->push_back(*$2);                }
+    : /* nothing */            { $$ = newArena<ast::astVec>(); }
+    | local_def_list local_def { $$ = $1; $$->push_back($2);   }
     ;
 
 fpar_def
-    : T_id ':' "reference" type { $$ = new ast::astPtr(newShared<ast::Param>(std::string($1), sem::PassMode::REFERENCE, *$4)); }
-    | T_id ':' type             { $$ = new ast::astPtr(newShared<ast::Param>(std::string($1), sem::PassMode::VALUE, *$3));     }
+    : T_id ':' "reference" type { $$ = newNode<ast::Param>($1, sem::PassMode::REFERENCE, $4); }
+    | T_id ':' type             { $$ = newNode<ast::Param>($1, sem::PassMode::VALUE, $3);     }
     ;
 
 fpar_list
-    : /* nothing */          { $$ = new ast::astVec(); vecs.push_back($$);                     }
-    | fpar_list ',' fpar_def { $$ = $1; $$->push_back(*$3);                                    }
-    | fpar_def               { $$ = new ast::astVec(); $$->push_back(*$1); vecs.push_back($$); }
+    : /* nothing */          { $$ = newArena<ast::astVec>();                    }
+    | fpar_list ',' fpar_def { $$ = $1; $$->push_back($3);                      }
+    | fpar_def               { $$ = newArena<ast::astVec>(); $$->push_back($1); }
     ;
 
 func_def
-    : T_id '(' fpar_list ')' ':' r_type local_def_list compound_stmt { $$ = new ast::astPtr(newShared<ast::Func>(std::string($1), *$3, *$6, *$7, *$8)); nodes.push_back($$); }
+    : T_id '(' fpar_list ')' ':' r_type local_def_list compound_stmt { $$ = newNode<ast::Func>($1, std::move(*$3), $6, std::move(*$7), $8); }
     ;
 
 program
-    : func_def { t = $$ = $1; }
+    : func_def { ctx->root = $$ = $1; }
     ;
 
 %%
 
-void yyerror(const char *msg) {
+void yyerror(ParseContext *ctx, const char *msg) {
     fprintf(stderr, "Alan error: %s\n", msg);
     fprintf(stderr, "Aborting!\nYou made a stupid mistake in line %d\n", linecount);
     exit(-1);
 }
 
-void clearNodes() {
-    int i;
-    for ( i = 0; i < nodes.size(); i++ )
-        delete nodes[i];
-    for ( i = 0; i < types.size(); i++ )
-        delete types[i];
-    for ( i = 0; i < vecs.size(); i++ )
-        delete vecs[i];
-}
-
-ast::astPtr parse() {
-    if ( yyparse() )
+/*******************************************************************************
+ * Every node, vector and type created here lives in the arena.
+ * They are all released at once when the compilation ends.
+ *******************************************************************************/
+ast::astPtr parse(const char *source) {
+    ParseContext ctx;
+    scanBegin(&ctx, source);
+    int failed = yyparse(&ctx);
+    scanEnd(&ctx);
+    if ( failed )
         return nullptr;
-    ast::astPtr toRet = *t;
-    clearNodes();
-    return toRet;
+    return ctx.root;
 }
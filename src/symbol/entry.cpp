@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <memory>
+#include <unordered_set>
 #include <vector>
 
 #include <message/message.hpp>
@@ -25,53 +26,63 @@ namespace sem {
  *******************************************************************************/
 
 int Entry::getOffset() {
-    error("Not a variable/parameter (", this->id, ")");
+    error("Not a variable/parameter (", symbolName(this->id), ")");
     return -1;
 }
 
 void Entry::setOffset(int offset) {
-    error("Not a variable/parameter (", this->id, ")");
+    error("Not a variable/parameter (", symbolName(this->id), ")");
 }
 
 int Entry::getReturns() {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
     return -1;
 }
 
 const EntryVector& Entry::getParams() const {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
 }
 
 const EntryVector& Entry::getHidden() const {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
 }
 
 PassMode Entry::getMode() {
-    error("Not a parameter (", this->id, ")");
+    error("Not a parameter (", symbolName(this->id), ")");
     return PassMode::VALUE;
 }
 
 void Entry::addParam(EntryPtr param) {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
     return;
 }
 
 void Entry::addHidden(EntryPtr entry) {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
     return;
 }
 
 void Entry::addReturn() {
-    error("Not a function (", this->id, ")");
+    error("Not a function (", symbolName(this->id), ")");
     return;
 }
 
+void Entry::addCall(EntryPtr callee) {
+    error("Not a function (", symbolName(this->id), ")");
+    return;
+}
+
+bool Entry::isRecursive() {
+    error("Not a function (", symbolName(this->id), ")");
+    return true;
+}
+
 /*******************************************************************************
  ******************************* Variable Class ********************************
  *******************************************************************************/
 
-EntryVariable::EntryVariable(std::string id, TypePtr type) {
-    this->id = std::move(id);
+EntryVariable::EntryVariable(SymbolId id, TypePtr type) {
+    this->id = id;
     this->type = type;
     this->eType = EntryType::VARIABLE;
 }
@@ -85,20 +96,30 @@ void EntryVariable::setOffset(int offset) {
 }
 
 void EntryVariable::print(std::string prefix) {
-    std::cout << prefix << " Variable : " << this->id << std::endl;
+    std::cout << prefix << " Variable : " << symbolName(this->id) << std::endl;
 }
 
 /*******************************************************************************
  ******************************* Function Class ********************************
  *******************************************************************************/
 
-EntryFunction::EntryFunction(std::string id, TypePtr type) {
-    this->id = std::move(id);
+EntryFunction::EntryFunction(SymbolId id, TypePtr type) {
+    this->id = id;
     this->type = type;
+    this->offset = -1;
     this->returns = 0;
+    this->recursive = -1;
     this->eType = EntryType::FUNCTION;
 }
 
+int EntryFunction::getOffset() {
+    return this->offset;
+}
+
+void EntryFunction::setOffset(int offset) {
+    this->offset = offset;
+}
+
 int EntryFunction::getReturns() {
     return this->returns;
 }
@@ -123,8 +144,37 @@ void EntryFunction::addReturn() {
     this->returns++;
 }
 
+void EntryFunction::addCall(EntryPtr callee) {
+    for ( auto c : this->calls )
+        if ( c == callee.get() )
+            return;
+    this->calls.push_back(callee.get());
+}
+
+/*******************************************************************************
+ * A function is recursive if it can reach itself in the call graph.
+ * Library functions have no calls, so they are never recursive.
+ *******************************************************************************/
+static bool reaches(Entry *from, Entry *target, std::unordered_set<Entry *> &seen) {
+    for ( auto c : static_cast<EntryFunction *>(from)->calls ) {
+        if ( c == target )
+            return true;
+        if ( seen.insert(c).second && reaches(c, target, seen) )
+            return true;
+    }
+    return false;
+}
+
+bool EntryFunction::isRecursive() {
+    if ( this->recursive < 0 ) {
+        std::unordered_set<Entry *> seen;
+        this->recursive = reaches(this, this, seen);
+    }
+    return this->recursive;
+}
+
 void EntryFunction::print(std::string prefix) {
-    std::cout << prefix << " Function : " << this->id << std::endl;
+    std::cout << prefix << " Function : " << symbolName(this->id) << std::endl;
     std::string mid(prefix.size(), ' ');
     mid += "`-";
     std::cout << mid << " with parameters :" << std::endl;
@@ -141,12 +191,12 @@ void EntryFunction::print(std::string prefix) {
  ******************************* Parameter Class *******************************
  *******************************************************************************/
 
-EntryParameter::EntryParameter(std::string id, TypePtr type, PassMode mode) {
+EntryParameter::EntryParameter(SymbolId id, TypePtr type, PassMode mode) {
     if ( type->t == genType::IARRAY 
             && mode != PassMode::REFERENCE ) {
         error("Arrays must always be passed by reference");
     }
-    this->id = std::move(id);
+    this->id = id;
     this->type = type;
     this->mode = mode;
     this->eType = EntryType::PARAMETER;
@@ -165,7 +215,7 @@ PassMode EntryParameter::getMode() {
 }
 
 void EntryParameter::print(std::string prefix) {
-    std::cout << prefix << " Parameter : " << this->id << std::endl;
+    std::cout << prefix << " Parameter : " << symbolName(this->id) << std::endl;
 }
 
 } // end namespace sem
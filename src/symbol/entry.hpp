@@ -16,6 +16,7 @@
 #include <memory>
 #include <vector>
 
+#include <general/intern.hpp>
 #include <symbol/types.hpp>
 
 /*******************************************************************************
@@ -23,13 +24,16 @@
  *   - Variable :
  *     - name
  *     - type
+ *     - offset ( slot in its function )
  *   - Parameter :
  *     - name
  *     - type
  *     - passmode (value or reference)
+ *     - offset ( slot in its function )
  *   - Function :
  *     - name
  *     - type
+ *     - offset ( slot in the program )
  *     - number of returns :
  *       > Needed for semantic analysis.
  *       > A non proc function must have at least one return statement.
@@ -40,6 +44,12 @@
  *       > analysis. When we find them we need to pass them
  *       > as reference parameters to the function so as not
  *       > to intervene with llvm stack frames.
+ *     - calls :
+ *       > Functions called from its body ( the call graph ).
+ *       > Complete once semantic analysis is over, used by codegen
+ *       > to know which functions may be active more than once.
+ *       > Plain pointers, since recursion would make shared ones leak
+ *       > ( the ast keeps every function entry alive ).
  *******************************************************************************/
 
 namespace sem {
@@ -75,7 +85,7 @@ enum class PassMode {
 class Entry {
     public :
         // Variables
-        std::string  id;
+        SymbolId     id;
         EntryType    eType;
         TypePtr      type;
         unsigned int nestingLevel;
@@ -92,6 +102,8 @@ class Entry {
         virtual void addParam(EntryPtr param);
         virtual void addHidden(EntryPtr entry);
         virtual void addReturn();
+        virtual void addCall(EntryPtr callee);
+        virtual bool isRecursive();
 
         virtual void print(std::string prefix) = 0;
 };
@@ -106,7 +118,7 @@ class EntryVariable : public Entry {
         int offset;
 
         // Methods
-        EntryVariable(std::string id, TypePtr type);
+        EntryVariable(SymbolId id, TypePtr type);
         virtual ~EntryVariable() {  }
 
         int getOffset();
@@ -122,20 +134,27 @@ class EntryVariable : public Entry {
 class EntryFunction : public Entry {
     public :
         // Variables
+        int         offset;
         int         returns;
+        int         recursive;
         EntryVector params;
         EntryVector hidden;
+        std::vector<Entry *> calls;
 
         // Methods
-        EntryFunction(std::string id, TypePtr type);
+        EntryFunction(SymbolId id, TypePtr type);
         virtual ~EntryFunction() {  }
 
+        int getOffset();
+        void setOffset(int offset);
         int getReturns();
         const EntryVector& getParams() const;
         const EntryVector& getHidden() const;
         void addParam(EntryPtr param);
         void addHidden(EntryPtr entry);
         void addReturn();
+        void addCall(EntryPtr callee);
+        bool isRecursive();
 
         void print(std::string prefix);
 };
@@ -151,7 +170,7 @@ class EntryParameter : public Entry {
         PassMode mode;
 
         // Methods
-        EntryParameter(std::string id, TypePtr type, PassMode mode);
+        EntryParameter(SymbolId id, TypePtr type, PassMode mode);
         virtual ~EntryParameter() {  }
 
         int getOffset();
@@ -0,0 +1,168 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : interface.cpp                                                *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Module interface files                                       *
+ *                                                                             *
+ *******************************************************************************/
+
+#include <cctype>
+#include <fstream>
+#include <string>
+
+#include <general/general.hpp>
+#include <message/message.hpp>
+#include <symbol/interface.hpp>
+#include <symbol/types.hpp>
+
+namespace sem {
+
+EntryVector imports;
+
+/*******************************************************************************
+ ******************************** Reading Headers ******************************
+ *******************************************************************************/
+
+/*******************************************************************************
+ * Reads one function header of an interface file :
+ *   - header : id '(' [ param { ',' param } ] ')' ':' ( int | byte | proc )
+ *   - param  : id ':' [ reference ] ( int | byte ) [ '[' ']' ]
+ *******************************************************************************/
+class HeaderReader {
+    private :
+        const std::string &line;
+        const char        *path;
+        std::size_t        pos = 0;
+
+        void fail() {
+            error("Malformed interface file ", path, ": ", line);
+        }
+        void blanks() {
+            while ( pos < line.size() && isspace(line[pos]) )
+                pos++;
+        }
+        bool accept(char c) {
+            blanks();
+            if ( pos < line.size() && line[pos] == c ) {
+                pos++;
+                return true;
+            }
+            return false;
+        }
+        void expect(char c) {
+            if ( !accept(c) )
+                fail();
+        }
+        std::string word() {
+            blanks();
+            std::size_t start = pos;
+            while ( pos < line.size() && ( isalnum(line[pos]) || line[pos] == '_' ) )
+                pos++;
+            if ( start == pos )
+                fail();
+            return line.substr(start, pos - start);
+        }
+        TypePtr baseType(const std::string &name, bool allowProc) {
+            if ( name == "int" )
+                return typeInteger;
+            if ( name == "byte" )
+                return typeByte;
+            if ( allowProc && name == "proc" )
+                return typeVoid;
+            fail();
+            return nullptr;
+        }
+        EntryPtr param() {
+            SymbolId id = intern(word());
+            expect(':');
+            std::string name = word();
+            PassMode mode = PassMode::VALUE;
+            if ( name == "reference" ) {
+                mode = PassMode::REFERENCE;
+                name = word();
+            }
+            TypePtr type = baseType(name, false);
+            if ( accept('[') ) {
+                expect(']');
+                type = typeIArray(type);
+            }
+            return newShared<EntryParameter>(id, type, mode);
+        }
+    public :
+        HeaderReader(const std::string &line, const char *path) : line(line), path(path) {  }
+
+        EntryPtr read() {
+            SymbolId id = intern(word());
+            expect('(');
+            EntryVector params;
+            if ( !accept(')') ) {
+                do {
+                    params.push_back(param());
+                } while ( accept(',') );
+                expect(')');
+            }
+            expect(':');
+            auto fun = newShared<EntryFunction>(id, baseType(word(), true));
+            for ( auto& p : params )
+                fun->addParam(p);
+            blanks();
+            if ( pos != line.size() )
+                fail();
+            return fun;
+        }
+};
+
+EntryVector loadInterface(const char *path) {
+    std::ifstream in(path);
+    if ( !in )
+        fatal("Cannot open interface file ", path);
+    EntryVector ret;
+    std::string line;
+    while ( std::getline(in, line) ) {
+        auto first = line.find_first_not_of(" \t\r");
+        if ( first == std::string::npos || line.compare(first, 2, "--") == 0 )
+            continue;
+        ret.push_back(HeaderReader(line, path).read());
+    }
+    return ret;
+}
+
+/*******************************************************************************
+ ******************************** Writing Headers ******************************
+ *******************************************************************************/
+
+static std::string alanType(TypePtr type) {
+    switch ( type->t ) {
+        case genType::VOID :
+            return "proc";
+        case genType::INT :
+            return "int";
+        case genType::BYTE :
+            return "byte";
+        default :
+            return alanType(type->getRef()) + "[]";
+    }
+}
+
+void writeInterface(const char *path, EntryPtr fun) {
+    std::ofstream out(path);
+    if ( !out )
+        fatal("Cannot write interface file ", path);
+    out << "-- Alan interface of " << filename << std::endl;
+    out << symbolName(fun->id) << " (";
+    bool first = true;
+    for ( auto& p : fun->getParams() ) {
+        out << ( first ? "" : ", " ) << symbolName(p->id) << " : ";
+        if ( p->getMode() == PassMode::REFERENCE )
+            out << "reference ";
+        out << alanType(p->type);
+        first = false;
+    }
+    out << ") : " << alanType(fun->type) << std::endl;
+}
+
+} // end namespace sem
@@ -0,0 +1,49 @@
+/*******************************************************************************
+ *                                                                             *
+ *  Filename    : interface.hpp                                                *
+ *  Project     : Alan Compiler                                                *
+ *  Version     : 1.0                                                          *
+ *  Author      : Spiros Dontas                                                *
+ *  Email       : spirosdontas@gmail.com                                       *
+ *                                                                             *
+ *  Description : Module interface files                                       *
+ *                                                                             *
+ *******************************************************************************/
+
+#ifndef __INTERFACE_HPP__
+#define __INTERFACE_HPP__
+
+#include <symbol/entry.hpp>
+
+/*******************************************************************************
+ * Module interfaces :
+ *   - A module ( compiled with --module ) exports its top-level function.
+ *   > Its interface file holds the header of that function in Alan syntax,
+ *   > e.g. `sort (n : int, a : reference int[]) : proc`.
+ *   > Lines starting with "--" are comments.
+ *   - Other files load interfaces with --import=FILE. The functions are put in
+ *   > the global scope after the standard library ( check Table::addImports )
+ *   > and codegen declares them as external ( in the same order, so they get
+ *   > the same slots ).
+ *******************************************************************************/
+
+namespace sem {
+
+/*******************************************************************************
+ * Functions loaded from interface files, in the order they were inserted.
+ *******************************************************************************/
+extern EntryVector imports;
+
+/*******************************************************************************
+ * Returns the functions of an interface file.
+ *******************************************************************************/
+EntryVector loadInterface(const char *path);
+
+/*******************************************************************************
+ * Writes the interface of an exported function.
+ *******************************************************************************/
+void writeInterface(const char *path, EntryPtr fun);
+
+} // end namespace sem
+
+#endif
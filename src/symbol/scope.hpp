@@ -13,6 +13,9 @@
 #ifndef __SCOPE_HPP__
 #define __SCOPE_HPP__
 
+#include <vector>
+
+#include <general/intern.hpp>
 #include <symbol/entry.hpp>
 
 namespace sem {
@@ -26,15 +29,19 @@ class Scope;
 typedef std::shared_ptr<Scope> ScopePtr;
 
 /*******************************************************************************
- ********************************* Scope Class *********************************
+ * Scope :
+ *   - names :
+ *     > Undo log of the ids whose entry stacks got a new entry
+ *     > in this scope. Closing the scope pops exactly these.
  *******************************************************************************/
 
 class Scope {
     public :
         // Variables
-        unsigned int nestingLevel;
-        unsigned int currentOffset;
-        EntryPtr     fun;
+        unsigned int          nestingLevel;
+        unsigned int          currentOffset;
+        EntryPtr              fun;
+        std::vector<SymbolId> names;
 
         // Methods
         Scope(unsigned int nestingLevel, EntryPtr fun);
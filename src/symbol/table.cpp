@@ -17,7 +17,9 @@
 #include <symbol/types.hpp>
 #include <symbol/entry.hpp>
 #include <symbol/table.hpp>
+#include <symbol/interface.hpp>
 #include <general/general.hpp>
+#include <options/options.hpp>
 
 namespace sem {
 
@@ -35,10 +37,11 @@ void Table::openScope(EntryPtr fun) {
 }
 
 /*******************************************************************************
- * For each entry name :
- * > remove the entry with the same nesting
- * > level as the scopes function
+ * For each name inserted in the closing scope :
+ * > remove the front entry of its stack
  *
+ * Inner scopes are already closed, so the front
+ * entry is always the one this scope inserted.
  * We do not need to check what type of
  * entry we are deleting, as functions are
  * always inserted a level above the current
@@ -50,14 +53,12 @@ void Table::closeScope() {
         warning("No scopes to close");
         return;
     }
-    unsigned int nestingLevel = scopes.front()->nestingLevel;
-    for ( auto& e : this->entries ) {
-        auto& s = e.second;
-        while ( !s.empty() ) {
-            if ( s.front()->nestingLevel < nestingLevel )
-                break;
-            s.pop_front();
-        }
+    auto& names = scopes.front()->names;
+    for ( auto it = names.rbegin(); it != names.rend(); ++it ) {
+        auto e = this->entries.find(*it);
+        e->second.pop_front();
+        if ( e->second.empty() )
+            this->entries.erase(e);
     }
     scopes.pop_front();
 }
@@ -74,11 +75,14 @@ void Table::addParam(EntryPtr entry) {
     scopes.front()->getFunction()->addParam(entry);
 }
 
-void Table::addHidden(EntryPtr entry) {
+/*******************************************************************************
+ * Returns the hidden parameter entry of the current scope.
+ *******************************************************************************/
+EntryPtr Table::addHidden(EntryPtr entry) {
     unsigned int nestingLevel = entry->nestingLevel;
     if ( entry->type->t == genType::ARRAY ) {
         entry = newShared<EntryParameter>( entry->id,
-                                           newShared<TypeIArray>(entry->type->getRef()),
+                                           typeIArray(entry->type->getRef()),
                                            PassMode::REFERENCE );
     }
     for ( unsigned int i = 0; i < scopes.size(); i++ ) {
@@ -87,19 +91,21 @@ void Table::addHidden(EntryPtr entry) {
         else
             break;
     }
-    for ( unsigned int i = nestingLevel + 1; ; i++ ) {
-        EntryPtr temp;
-        if ( entry->type->t == genType::ARRAY )
-            temp = newShared<EntryParameter>( entry->id,
-                                              newShared<TypeIArray>(entry->type->getRef()),
-                                              PassMode::REFERENCE );
-        else
-            temp = newShared<EntryParameter>( entry->id, entry->type, PassMode::REFERENCE );
+    /**
+     * Every level between the entry and the current scope sees
+     * the entry as a hidden reference parameter of its own.
+     * Push them outermost first, each logged in its own scope.
+     */
+    auto& stack = entries[entry->id];
+    unsigned int current = scopes.front()->nestingLevel;
+    for ( unsigned int i = nestingLevel + 1; i <= current; i++ ) {
+        auto temp = newShared<EntryParameter>( entry->id, entry->type, PassMode::REFERENCE );
         temp->nestingLevel = i;
-        entries[entry->id].push_front(temp);
-        if ( i == scopes.front()->nestingLevel )
-            break;
+        temp->setOffset(scopes[current - i]->currentOffset++);
+        stack.push_front(temp);
+        scopes[current - i]->names.push_back(entry->id);
     }
+    return stack.front();
 }
 
 void Table::insertEntry(EntryPtr entry) {
@@ -110,29 +116,32 @@ void Table::insertEntry(EntryPtr entry) {
             entry->setOffset(scopes.front()->currentOffset++);
             break;
         case EntryType::FUNCTION :
+            entry->setOffset(this->functions++);
             break;
     }
     entries[entry->id].push_front(entry);
+    scopes.front()->names.push_back(entry->id);
     return;
 }
 
-EntryPtr Table::lookupEntry(std::string id, Lookup l, bool err) {
+const EntryPtr& Table::lookupEntry(SymbolId id, Lookup l, bool err) {
+    static const EntryPtr notFound = nullptr;
     auto exists = this->entries.find(id);
     if ( exists == this->entries.end() ) {
         if (err)
-            error("Unknown identifier ", id);
-        return nullptr;
+            error("Unknown identifier ", symbolName(id));
+        return notFound;
     }
-    auto s = this->entries[id];
+    auto& s = exists->second;
     switch( l ) {
         case Lookup::CURRENT :
             if ( s.front()->nestingLevel != this->scopes.front()->nestingLevel )
-                return nullptr;
+                return notFound;
             return s.front();
         case Lookup::ALL :
             return s.front();
     }
-    return nullptr;
+    return notFound;
 }
 
 ScopePtr Table::getScope() {
@@ -147,7 +156,7 @@ void Table::addLibs() {
     /**
      * Global scope pseudofunction
      */
-    auto global = newShared<EntryFunction>("global", typeVoid);
+    auto global = newShared<EntryFunction>(intern("global"), typeVoid);
     this->openScope(global);
     /**
      * Standard library functions :
@@ -167,67 +176,90 @@ void Table::addLibs() {
      *   - void strcat(reference byte trg, reference byte src)
      */
     /* void writeInteger(int n) */
-    auto writeInteger = newShared<EntryFunction>("writeInteger", typeVoid);
-    writeInteger->addParam(newShared<EntryParameter>("n", typeInteger, PassMode::VALUE));
+    auto writeInteger = newShared<EntryFunction>(intern("writeInteger"), typeVoid);
+    writeInteger->addParam(newShared<EntryParameter>(intern("n"), typeInteger, PassMode::VALUE));
     this->insertEntry(writeInteger);
     /* void writeByte(byte b) */
-    auto writeByte = newShared<EntryFunction>("writeByte", typeVoid);
-    writeByte->addParam(newShared<EntryParameter>("b", typeByte, PassMode::VALUE));
+    auto writeByte = newShared<EntryFunction>(intern("writeByte"), typeVoid);
+    writeByte->addParam(newShared<EntryParameter>(intern("b"), typeByte, PassMode::VALUE));
     this->insertEntry(writeByte);
     /* void writeChar(byte b) */
-    auto writeChar = newShared<EntryFunction>("writeChar", typeVoid);
-    writeChar->addParam(newShared<EntryParameter>("b", typeByte, PassMode::VALUE));
+    auto writeChar = newShared<EntryFunction>(intern("writeChar"), typeVoid);
+    writeChar->addParam(newShared<EntryParameter>(intern("b"), typeByte, PassMode::VALUE));
     this->insertEntry(writeChar);
     /* void writeString(reference byte s) */
-    auto writeString = newShared<EntryFunction>("writeString", typeVoid);
-    writeString->addParam(newShared<EntryParameter>("s", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto writeString = newShared<EntryFunction>(intern("writeString"), typeVoid);
+    writeString->addParam(newShared<EntryParameter>(intern("s"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(writeString);
     /* int readInteger() */
-    auto readInteger = newShared<EntryFunction>("readInteger", typeInteger);
+    auto readInteger = newShared<EntryFunction>(intern("readInteger"), typeInteger);
     this->insertEntry(readInteger);
     /* byte readByte() */
-    auto readByte = newShared<EntryFunction>("readByte", typeByte);
+    auto readByte = newShared<EntryFunction>(intern("readByte"), typeByte);
     this->insertEntry(readByte);
     /* byte readChar() */
-    auto readChar = newShared<EntryFunction>("readChar", typeByte);
+    auto readChar = newShared<EntryFunction>(intern("readChar"), typeByte);
     this->insertEntry(readChar);
     /* void readString(int n, reference byte s) */
-    auto readString = newShared<EntryFunction>("readString", typeVoid);
-    readString->addParam(newShared<EntryParameter>("n", typeInteger, PassMode::VALUE));
-    readString->addParam(newShared<EntryParameter>("s", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto readString = newShared<EntryFunction>(intern("readString"), typeVoid);
+    readString->addParam(newShared<EntryParameter>(intern("n"), typeInteger, PassMode::VALUE));
+    readString->addParam(newShared<EntryParameter>(intern("s"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(readString);
     /* int extend(byte b) */
-    auto extend = newShared<EntryFunction>("extend", typeInteger);
-    extend->addParam(newShared<EntryParameter>("b", typeByte, PassMode::VALUE));
+    auto extend = newShared<EntryFunction>(intern("extend"), typeInteger);
+    extend->addParam(newShared<EntryParameter>(intern("b"), typeByte, PassMode::VALUE));
     this->insertEntry(extend);
     /* byte shrink(int i) */
-    auto shrink = newShared<EntryFunction>("shrink", typeByte);
-    shrink->addParam(newShared<EntryParameter>("i", typeInteger, PassMode::VALUE));
+    auto shrink = newShared<EntryFunction>(intern("shrink"), typeByte);
+    shrink->addParam(newShared<EntryParameter>(intern("i"), typeInteger, PassMode::VALUE));
     this->insertEntry(shrink);
     /* int strlen(reference byte s) */
-    auto astrlen = newShared<EntryFunction>("strlen", typeInteger);
-    astrlen->addParam(newShared<EntryParameter>("s", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto astrlen = newShared<EntryFunction>(intern("strlen"), typeInteger);
+    astrlen->addParam(newShared<EntryParameter>(intern("s"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(astrlen);
     /* int strcmp(reference byte s1, reference byte s2) */
-    auto astrcmp = newShared<EntryFunction>("strcmp", typeInteger);
-    astrcmp->addParam(newShared<EntryParameter>("s1", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
-    astrcmp->addParam(newShared<EntryParameter>("s2", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto astrcmp = newShared<EntryFunction>(intern("strcmp"), typeInteger);
+    astrcmp->addParam(newShared<EntryParameter>(intern("s1"), typeIArray(typeByte), PassMode::REFERENCE));
+    astrcmp->addParam(newShared<EntryParameter>(intern("s2"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(astrcmp);
     /* void strcpy(reference byte trg, reference byte src) */
-    auto astrcpy = newShared<EntryFunction>("strcpy", typeInteger);
-    astrcpy->addParam(newShared<EntryParameter>("trg", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
-    astrcpy->addParam(newShared<EntryParameter>("src", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto astrcpy = newShared<EntryFunction>(intern("strcpy"), typeInteger);
+    astrcpy->addParam(newShared<EntryParameter>(intern("trg"), typeIArray(typeByte), PassMode::REFERENCE));
+    astrcpy->addParam(newShared<EntryParameter>(intern("src"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(astrcpy);
     /* void strcat(reference byte trg, reference byte src) */
-    auto astrcat = newShared<EntryFunction>("strcat", typeInteger);
-    astrcat->addParam(newShared<EntryParameter>("trg", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
-    astrcat->addParam(newShared<EntryParameter>("src", newShared<TypeIArray>(typeByte), PassMode::REFERENCE));
+    auto astrcat = newShared<EntryFunction>(intern("strcat"), typeInteger);
+    astrcat->addParam(newShared<EntryParameter>(intern("trg"), typeIArray(typeByte), PassMode::REFERENCE));
+    astrcat->addParam(newShared<EntryParameter>(intern("src"), typeIArray(typeByte), PassMode::REFERENCE));
     this->insertEntry(astrcat);
 }
 
+/*******************************************************************************
+ ****************************** Imported Modules *******************************
+ *******************************************************************************/
+
+/*******************************************************************************
+ * Functions of the interface files given with --import=FILE live in the
+ * global scope next to the standard library, so they take the slots right
+ * after it. They are kept in `imports` for codegen to declare.
+ *******************************************************************************/
+void Table::addImports() {
+    for ( auto& path : options.imports ) {
+        for ( auto& fun : loadInterface(path.c_str()) ) {
+            if ( this->lookupEntry(fun->id, Lookup::CURRENT, false) != nullptr ) {
+                error("Duplicate identifier ", symbolName(fun->id), " in ", path);
+                return;
+            }
+            this->insertEntry(fun);
+            imports.push_back(fun);
+        }
+    }
+}
+
 SymbolTable initSymbolTable() {
     SymbolTable ret = newShared<Table>();
     ret->addLibs();
+    ret->addImports();
     return ret;
 }
 
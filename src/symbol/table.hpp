@@ -24,14 +24,19 @@
 /*******************************************************************************
  * Symbol Table for Semantic Analysis :
  *   - HashTable of variables
- *     > Every symbol table entry is inserted here.
+ *     > Every symbol table entry is inserted here, keyed by interned id.
  *     > To emulate a normal HashTable ( that is allow more than one entry of
  *     > the same name ), we use a stack. However, one cannot add an entry of
  *     > the same scope to the table and an error occurs.
+ *     > Lookups return a reference to the top of the stack, nothing is copied.
  *   - Stack of scopes
  *     > Every scope is linked to a function.
- *     > Also helps with nestingLevel determining which entries to clean up
- *     > when closing a scope.
+ *     > Every scope remembers the names it inserted, so closing it only
+ *     > touches its own entries.
+ *   - Slots
+ *     > Variables and parameters get the next offset of their scope,
+ *     > functions the next offset of the whole program ( in insertion
+ *     > order, so the standard library takes the first ones ).
  *******************************************************************************/
 
 namespace sem {
@@ -42,7 +47,7 @@ namespace sem {
 
 typedef std::deque<ScopePtr> ScopeStack;
 typedef std::deque<EntryPtr> EntryStack;
-typedef std::unordered_map<std::string, EntryStack> HashTable;
+typedef std::unordered_map<SymbolId, EntryStack> HashTable;
 
 /*******************************************************************************
  ******************************** Enumerations *********************************
@@ -60,19 +65,21 @@ enum class Lookup {
 class Table {
     public :
         // Variables
-        HashTable  entries;
-        ScopeStack scopes;
+        HashTable    entries;
+        ScopeStack   scopes;
+        unsigned int functions = 0;
 
         // Methods
         void openScope(EntryPtr fun);
         void closeScope();
         void addLibs();
+        void addImports();
         TypePtr scopeType();
         void addReturn();
         void addParam(EntryPtr entry);
-        void addHidden(EntryPtr entry);
+        EntryPtr addHidden(EntryPtr entry);
         void insertEntry(EntryPtr entry);
-        EntryPtr lookupEntry(std::string id, Lookup l, bool err);
+        const EntryPtr& lookupEntry(SymbolId id, Lookup l, bool err);
 
         ScopePtr getScope();
 };
@@ -82,7 +89,8 @@ typedef std::shared_ptr<Table> SymbolTable;
 /*******************************************************************************
  * Initializes the symbol table by creating a global scope.
  * It then inserts all lib functions to the table so that we
- * can perform semantic analysis ( calls addLibs() ).
+ * can perform semantic analysis ( calls addLibs() ), followed by
+ * the functions of imported modules ( calls addImports() ).
  *******************************************************************************/
 SymbolTable initSymbolTable();
 
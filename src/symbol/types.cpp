@@ -10,7 +10,11 @@
  *                                                                             *
  *******************************************************************************/
 
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include <symbol/types.hpp>
 #include <message/message.hpp>
@@ -22,6 +26,12 @@ namespace sem {
  *********************************** General ***********************************
  *******************************************************************************/
 
+static std::atomic<unsigned int> typeCounter(0);
+
+Type::Type() {
+    this->index = typeCounter++;
+}
+
 TypePtr Type::getRef() {
     return nullptr;
 }
@@ -127,25 +137,57 @@ std::ostream& TypeIArray::print(std::ostream &out) const {
 }
 
 /*******************************************************************************
- ***************************** Auxiliary Functions *****************************
+ ********************************** Type Pool **********************************
  *******************************************************************************/
 
-bool equalType(TypePtr a, TypePtr b) {
-    if ( a == b )
-        return true;
+/*******************************************************************************
+ * Array types are keyed by their element type ( already interned ) and
+ * their size ( -1 for iarrays ). The pool owns them.
+ * Types are immutable and shared by every thread, so only creating them
+ * takes the lock.
+ *******************************************************************************/
+struct TypeKey {
+    TypePtr ref;
+    int     size;
 
-    if ( a->t == b->t ) {
-        switch( a->t ) {
-            case genType::ARRAY :
-                if ( a->getSize() != b->getSize() )
-                    return false;
-            case genType::IARRAY :
-                return equalType(a->getRef(), b->getRef());
-        }
+    bool operator==(const TypeKey &other) const {
+        return ref == other.ref && size == other.size;
     }
-    return false;
+};
+
+struct TypeKeyHash {
+    std::size_t operator()(const TypeKey &key) const {
+        return std::hash<TypePtr>()(key.ref) * 31 + std::hash<int>()(key.size);
+    }
+};
+
+static std::unordered_map<TypeKey, std::unique_ptr<Type>, TypeKeyHash> pool;
+static std::mutex poolLock;
+
+TypePtr typeArray(int size, TypePtr type) {
+    std::lock_guard<std::mutex> guard(poolLock);
+    auto& t = pool[TypeKey{ type, size }];
+    if ( t == nullptr )
+        t.reset(new TypeArray(size, type));
+    return t.get();
+}
+
+TypePtr typeIArray(TypePtr type) {
+    std::lock_guard<std::mutex> guard(poolLock);
+    auto& t = pool[TypeKey{ type, -1 }];
+    if ( t == nullptr )
+        t.reset(new TypeIArray(type));
+    return t.get();
+}
+
+unsigned int typeCount() {
+    return typeCounter;
 }
 
+/*******************************************************************************
+ ***************************** Auxiliary Functions *****************************
+ *******************************************************************************/
+
 bool compatibleType(TypePtr a, TypePtr b) {
     if ( a == b )
         return true;
@@ -156,7 +198,7 @@ bool compatibleType(TypePtr a, TypePtr b) {
     if ( (a->t == genType::ARRAY && b->t == genType::IARRAY) 
             || (a->t == genType::IARRAY && b->t == genType::ARRAY)
        ) {
-        return compatibleType(a->getRef(), b->getRef());
+        return a->getRef() == b->getRef();
     }
 
     return false;
@@ -166,8 +208,12 @@ bool compatibleType(TypePtr a, TypePtr b) {
  ******************************* Constant Types ********************************
  *******************************************************************************/
 
-TypePtr typeInteger = newShared<TypeInt>();
-TypePtr typeByte    = newShared<TypeByte>();
-TypePtr typeVoid    = newShared<TypeVoid>();
+static TypeInt  integerType;
+static TypeByte byteType;
+static TypeVoid voidType;
+
+TypePtr typeInteger = &integerType;
+TypePtr typeByte    = &byteType;
+TypePtr typeVoid    = &voidType;
 
 } // end namespace sem
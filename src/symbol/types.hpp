@@ -13,7 +13,7 @@
 #ifndef __TYPES_HPP__
 #define __TYPES_HPP__
 
-#include <memory>
+#include <iostream>
 
 /*******************************************************************************
  * Alan Types :
@@ -22,6 +22,11 @@
  *   - proc -> void
  *   - array -> of { int, byte } [ size ]
  *   - iarray -> reference array
+ *
+ * Types are hash-consed : every distinct type exists exactly once, so two
+ * types are equal iff they are the same pointer. Array types must be made
+ * through `typeArray` and `typeIArray`, never constructed directly.
+ * Every type also gets a dense index, useful for per type caches.
  *******************************************************************************/
 
 namespace sem {
@@ -35,7 +40,11 @@ namespace sem {
 
 class Type;
 
-typedef std::shared_ptr<Type> TypePtr;
+/*******************************************************************************
+ * Types are owned by the type pool ( or are static constants ),
+ * so plain pointers are enough.
+ *******************************************************************************/
+typedef Type * TypePtr;
 
 /*******************************************************************************
  *************************** TYPES ENUMERATION CLASS ***************************
@@ -56,9 +65,11 @@ enum class genType {
 class Type {
     public :
         // Variables
-        genType t;
+        genType      t;
+        unsigned int index;
 
         // Methods
+        Type();
         virtual ~Type() {  }
 
         // To be inherited
@@ -142,10 +153,23 @@ class TypeIArray : public Type {
  ***************************** Auxiliary Functions *****************************
  *******************************************************************************/
 
+/*******************************************************************************
+ * Interned array types.
+ *******************************************************************************/
+TypePtr typeArray(int size, TypePtr type);
+TypePtr typeIArray(TypePtr type);
+
+/*******************************************************************************
+ * Number of types created so far ( all indices are below it ).
+ *******************************************************************************/
+unsigned int typeCount();
+
 /*******************************************************************************
  * Called in assignments etc.
  *******************************************************************************/
-bool equalType(TypePtr a, TypePtr b);
+inline bool equalType(TypePtr a, TypePtr b) {
+    return a == b;
+}
 
 /*******************************************************************************
  * Called in function calls